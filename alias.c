@@ -0,0 +1,389 @@
+/**
+ * User-defined command aliases
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "alias.h"
+#include "ushell.h"
+#include "syslog.h"
+#include "variable.h"
+
+
+extern keystroke_handler_t current_keystroke_handler;
+extern int ushell_status;
+
+/*
+ * Each alias is stored as one entry in the arena:
+ *
+ *   [entry length] [name] '\0'
+ *   [sequence] [argc] [n] [n bytes of '\0'-terminated substrings]   (first command)
+ *   [sequence] [argc] [n] [n bytes of '\0'-terminated substrings]   (second command)
+ *   ...
+ *
+ * The sequence byte tells, how a command is chained to its predecessor.
+ */
+uint8_t alias_arena[USHELL_ALIAS_ARENA_SIZE];
+uint16_t alias_arena_used = 0;
+
+// incremented, whenever the arena changes, so that indexes of it can be rebuilt
+uint8_t alias_generation = 0;
+
+// copies of the aliases currently being expanded
+uint8_t* alias_chain[USHELL_ALIAS_MAX_DEPTH];
+uint8_t alias_depth = 0;
+
+#define alias_name(entry)       ((char*) &(entry)[1])
+#define alias_commands(entry)   (&(entry)[2 + strlen(alias_name(entry))])
+#define alias_end(entry)        (&(entry)[(entry)[0]])
+
+
+/**
+ * @brief Find the arena entry of an alias
+ */
+uint8_t* alias_find(char* name)
+{
+    uint16_t offset = 0;
+    while (offset < alias_arena_used)
+    {
+        uint8_t* entry = &alias_arena[offset];
+        if (strcmp(alias_name(entry), name) == 0)
+            return entry;
+        offset += entry[0];
+    }
+    return 0;
+}
+
+/**
+ * @brief Remove an alias from the arena
+ * @return false, if no such alias exists
+ */
+bool alias_remove(char* name)
+{
+    uint8_t* entry = alias_find(name);
+    if (entry == 0)
+        return false;
+
+    uint8_t l = entry[0];
+    uint8_t* next = entry + l;
+    memmove(entry, next, &alias_arena[alias_arena_used] - next);
+    alias_arena_used -= l;
+    alias_generation++;
+    return true;
+}
+
+/**
+ * @brief Store a new alias in the arena
+ * @return false, if there is not enough memory
+ */
+bool alias_define(char* name, char* definition)
+{
+    // assemble the entry, before replacing an existing one
+    uint8_t entry[255];
+    uint8_t* end = &entry[sizeof(entry)];
+    uint8_t l = strlen(name) + 1;
+
+    if (1 + l > sizeof(entry))
+    {
+        log_error("Not enough memory to store alias");
+        return false;
+    }
+    memcpy(alias_name(entry), name, l);
+    uint8_t* p = entry + 1 + l;
+
+    // tokenize a copy of the definition, one command at a time
+    char buffer[MAX_LENGTH];
+    strncpy(buffer, definition, MAX_LENGTH-1);
+    buffer[MAX_LENGTH-1] = '\0';
+
+    char* command = buffer;
+    ushell_sequence_t sequence = USHELL_SEQUENCE_ALWAYS;
+    while (command != 0)
+    {
+        ushell_sequence_t next_sequence;
+        char* next = ushell_split_commands(command, &next_sequence);
+
+        char* argv[MAX_SUBSTRINGS];
+        // variables are substituted upon invocation, not definition
+        uint8_t argc = ushell_tokenize(command, argv, MAX_SUBSTRINGS, 0, 0);
+        if (argc > 0)
+        {
+            // substrings are contiguous after tokenizing
+            uint8_t n = argv[argc-1] + strlen(argv[argc-1]) + 1 - argv[0];
+            if (p + 3 + n > end)
+            {
+                log_error("Not enough memory to store alias");
+                return false;
+            }
+            p[0] = sequence;
+            p[1] = argc;
+            p[2] = n;
+            memcpy(&p[3], argv[0], n);
+            p += 3 + n;
+        }
+        sequence = next_sequence;
+        command = next;
+    }
+    entry[0] = p - entry;
+
+    // the existing alias of the same name is replaced
+    uint8_t* existing = alias_find(name);
+    uint16_t freed = (existing == 0) ? 0 : existing[0];
+    if (alias_arena_used - freed + entry[0] > USHELL_ALIAS_ARENA_SIZE)
+    {
+        log_error("Not enough memory to store alias");
+        return false;
+    }
+    alias_remove(name);
+
+    memcpy(&alias_arena[alias_arena_used], entry, entry[0]);
+    alias_arena_used += entry[0];
+    alias_generation++;
+    return true;
+}
+
+/**
+ * @brief Reconstruct the textual definition of an alias
+ */
+void alias_definition(uint8_t* entry, char* buffer, uint8_t size)
+{
+    uint8_t l = 0;
+    buffer[0] = '\0';
+
+    // separators preceding a command, indexed by sequence byte
+    const char* sequence_separator[] = { "; ", " && ", " || " };
+
+    for (uint8_t* p=alias_commands(entry); p<alias_end(entry); p+=3+p[2])
+    {
+        char* s = (char*) &p[3];
+        for (uint8_t i=0; i<p[1]; i++)
+        {
+            const char* separator = (i > 0) ? " " : ((p > alias_commands(entry)) ? sequence_separator[p[0]] : "");
+            bool quote = (strchr(s, ' ') != 0);
+            uint8_t n = strlen(s);
+            if (l + strlen(separator) + n + 2*quote + 1 > size)
+                return;
+
+            strcpy(&buffer[l], separator);
+            l += strlen(separator);
+            if (quote)
+                buffer[l++] = '"';
+            memcpy(&buffer[l], s, n);
+            l += n;
+            if (quote)
+                buffer[l++] = '"';
+            buffer[l] = '\0';
+
+            s += n + 1;
+        }
+    }
+}
+
+/**
+ * @brief Print an alias in a form suitable for re-entering it
+ */
+void alias_print(uint8_t* entry)
+{
+    char buffer[2*MAX_LENGTH];
+    alias_definition(entry, buffer, sizeof(buffer));
+    write("alias ");
+    write(alias_name(entry));
+    write("='");
+    write(buffer);
+    writeln("'");
+}
+
+int ushell_alias(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    // list all aliases
+    if (argc == 1)
+    {
+        uint16_t offset = 0;
+        while (offset < alias_arena_used)
+        {
+            alias_print(&alias_arena[offset]);
+            offset += alias_arena[offset];
+        }
+        return USHELL_STATUS_SUCCESS;
+    }
+
+    // show one alias
+    char* equals = strchr(argv[1], '=');
+    if (equals == 0)
+    {
+        if (argc != 2)
+        {
+            log_error("Usage: alias [name[=definition]]");
+            return USHELL_STATUS_FAILURE;
+        }
+
+        uint8_t* entry = alias_find(argv[1]);
+        if (entry == 0)
+        {
+            log_error("Alias not found");
+            return USHELL_STATUS_FAILURE;
+        }
+        alias_print(entry);
+        return USHELL_STATUS_SUCCESS;
+    }
+
+    // separate name from definition
+    char* name = argv[1];
+    *equals = '\0';
+    argv[1] = equals+1;
+
+    // define alias, re-joining unquoted definitions
+    char definition[MAX_LENGTH];
+    if (argc == 2)
+    {
+        strncpy(definition, argv[1], MAX_LENGTH-1);
+        definition[MAX_LENGTH-1] = '\0';
+    }
+    else
+    {
+        uint8_t l = 0;
+        for (uint8_t i=1; i<argc; i++)
+        {
+            bool quote = (strchr(argv[i], ' ') != 0);
+            uint8_t n = strlen(argv[i]);
+            if (l + n + 2*quote + 2 > MAX_LENGTH)
+                break;
+            if (i > 1)
+                definition[l++] = ' ';
+            if (quote)
+                definition[l++] = '"';
+            memcpy(&definition[l], argv[i], n);
+            l += n;
+            if (quote)
+                definition[l++] = '"';
+        }
+        definition[l] = '\0';
+    }
+
+    return alias_define(name, definition) ? USHELL_STATUS_SUCCESS : USHELL_STATUS_FAILURE;
+}
+
+int ushell_unalias(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    if (argc != 2)
+    {
+        log_error("Usage: unalias <name>");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    if (!alias_remove(argv[1]))
+    {
+        log_error("Alias not found");
+        return USHELL_STATUS_FAILURE;
+    }
+    return USHELL_STATUS_SUCCESS;
+}
+
+bool ushell_alias_expand(uint8_t argc, char* argv[])
+{
+    uint8_t* found = alias_find(argv[0]);
+    if (found == 0)
+        return false;
+
+    // within its own expansion, the name refers to the command of the same name
+    for (uint8_t i=0; i<alias_depth; i++)
+        if (strcmp(alias_name(alias_chain[i]), argv[0]) == 0)
+            return false;
+
+    if (alias_depth >= USHELL_ALIAS_MAX_DEPTH)
+    {
+        log_error("Maximum alias expansion depth exceeded");
+        ushell_status = USHELL_STATUS_FAILURE;
+        return true;
+    }
+
+    // the commands may define or remove aliases, moving the arena's entries
+    uint8_t entry[255];
+    memcpy(entry, found, found[0]);
+    alias_chain[alias_depth++] = entry;
+    keystroke_handler_t handler = current_keystroke_handler;
+
+    for (uint8_t* p=alias_commands(entry); p<alias_end(entry); p+=3+p[2])
+    {
+        if (p[1] > MAX_SUBSTRINGS || p[2] > MAX_LENGTH)
+        {
+            log_error("Malformed alias");
+            ushell_status = USHELL_STATUS_FAILURE;
+            break;
+        }
+
+        // skip commands chained by && or ||, as the previous status demands
+        if (!ushell_sequence_due(p[0], ushell_status))
+            continue;
+
+        // copy pre-tokenized substrings, as applications may modify them
+        char buffer[MAX_LENGTH];
+        char* cv[MAX_SUBSTRINGS];
+        uint8_t cc = p[1];
+        memcpy(buffer, &p[3], p[2]);
+
+        char* s = buffer;
+        for (uint8_t i=0; i<cc; i++)
+        {
+            cv[i] = s;
+            s += strlen(s) + 1;
+        }
+
+        // substitute variables upon each invocation
+        char expansion[USHELL_VARIABLE_EXPANSION_SIZE];
+        uint16_t used = 0;
+        for (uint8_t i=0; i<cc && used<sizeof(expansion)-1; i++)
+        {
+            if (strchr(cv[i], '$') == 0)
+                continue;
+            ushell_variable_expand(cv[i], &expansion[used], sizeof(expansion)-used);
+            cv[i] = &expansion[used];
+            used += strlen(cv[i]) + 1;
+        }
+
+        // append the user's arguments to the last command
+        if (p + 3 + p[2] >= alias_end(entry))
+        {
+            for (uint8_t i=1; i<argc && cc<MAX_SUBSTRINGS; i++)
+                cv[cc++] = argv[i];
+        }
+
+        ushell_execute(cc, cv);
+
+        // stop, if an application remains running
+        if (current_keystroke_handler != handler)
+            break;
+    }
+
+    alias_depth--;
+    return true;
+}
+
+void ushell_alias_help()
+{
+    char buffer[2*MAX_LENGTH];
+    uint16_t offset = 0;
+    while (offset < alias_arena_used)
+    {
+        uint8_t* entry = &alias_arena[offset];
+        strcpy(buffer, "alias: ");
+        alias_definition(entry, &buffer[7], sizeof(buffer)-7);
+        ushell_help_row(alias_name(entry), buffer);
+        offset += entry[0];
+    }
+}
+
+char* ushell_alias_complete(char* user_input)
+{
+    uint16_t offset = 0;
+    while (offset < alias_arena_used)
+    {
+        uint8_t* entry = &alias_arena[offset];
+        if (beginning_matches(user_input, alias_name(entry)))
+            return alias_name(entry);
+        offset += entry[0];
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * User-defined command aliases
+ * ---------------------------------------------
+ *
+ * Aliases are stored pre-tokenized in a fixed-size arena,
+ * so that invoking an alias does not require parsing its definition.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_ALIAS_H
+#define USHELL_ALIAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scratch.h"
+
+// number of bytes available for storing all aliases
+#define USHELL_ALIAS_ARENA_SIZE     256
+
+// maximum number of nested alias expansions
+#define USHELL_ALIAS_MAX_DEPTH      4
+
+/**
+ * @brief Built-in command: alias [name[=definition]]
+ *
+ * Multiple commands in a definition are separated by ;, && or ||, e.g.
+ *   alias reset_all='reset adc; reset dac'
+ */
+int ushell_alias(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: unalias <name>
+ */
+int ushell_unalias(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Execute the alias named by argv[0], if it exists
+ *
+ * Further arguments are appended to the alias' last command.
+ *
+ * @return false, if argv[0] is not an alias
+ */
+bool ushell_alias_expand(uint8_t argc, char* argv[]);
+
+/**
+ * @brief Add all aliases to the help table
+ */
+void ushell_alias_help();
+
+/**
+ * @brief Find the first alias beginning with the given user input
+ * @return Name of the alias or 0, if no alias matches
+ */
+char* ushell_alias_complete(char* user_input);
+
+#endif // USHELL_ALIAS_H
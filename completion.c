@@ -0,0 +1,179 @@
+/**
+ * Argument completion
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "completion.h"
+#include "ushell.h"
+
+
+// candidates beginning with the argument typed so far
+const char* completion_cache[USHELL_COMPLETION_CACHE_SIZE];
+uint8_t completion_count = 0;
+
+// whether more candidates matched than fit into the cache
+bool completion_overflow = false;
+
+// command line, for which the cache was last filled or filtered
+char completion_line[MAX_LENGTH];
+// offset of the argument being completed
+uint8_t completion_argument = 0;
+bool completion_valid = false;
+
+
+/**
+ * @brief Cache a candidate, if it begins with the typed argument
+ * @return false, if the cache is full
+ */
+bool completion_add(const char* candidate, char* prefix, uint8_t length)
+{
+    if (strncmp(candidate, prefix, length) != 0)
+        return true;
+    if (completion_count >= USHELL_COMPLETION_CACHE_SIZE)
+    {
+        completion_overflow = true;
+        return false;
+    }
+    completion_cache[completion_count++] = candidate;
+    return true;
+}
+
+/**
+ * @brief Ask the application for all candidates beginning with the typed argument
+ *
+ * Within a command group, the candidates are its subcommands.
+ *
+ * @return false, if the application does not support completion
+ */
+bool completion_fill(char* line, uint8_t argument)
+{
+    // split a copy of the preceding arguments
+    char buffer[MAX_LENGTH];
+    memcpy(buffer, line, argument);
+    buffer[argument] = '\0';
+    char* argv[MAX_SUBSTRINGS];
+    uint8_t argc = ushell_tokenize(buffer, argv, MAX_SUBSTRINGS, 0, 0);
+    if (argc == 0 || argc >= MAX_SUBSTRINGS)
+        return false;
+
+    ushell_app_t* app = ushell_find_app(argv[0]);
+    if (app == 0)
+        return false;
+
+    // descend into command groups along the preceding arguments
+    uint8_t depth = ushell_find_subcommand(&app, argc, argv);
+    argc -= depth;
+
+    char* prefix = &line[argument];
+    uint8_t l = strlen(prefix);
+    completion_count = 0;
+    completion_overflow = false;
+
+    if (argc == 1 && app->children != 0)
+    {
+        for (uint16_t i=0; i<app->children->count; i++)
+            if (!completion_add(app->children->apps[i].name, prefix, l))
+                break;
+        return true;
+    }
+
+    if (app->complete == 0)
+        return false;
+    const char* candidate;
+    for (uint16_t i=0; (candidate = (*(app->complete))(argc, &argv[depth], i)) != 0; i++)
+        if (!completion_add(candidate, prefix, l))
+            break;
+    return true;
+}
+
+/**
+ * @brief Remove cached candidates not beginning with the typed argument
+ */
+void completion_filter(char* prefix)
+{
+    uint8_t l = strlen(prefix);
+    uint8_t n = 0;
+    for (uint8_t i=0; i<completion_count; i++)
+        if (strncmp(completion_cache[i], prefix, l) == 0)
+            completion_cache[n++] = completion_cache[i];
+    completion_count = n;
+}
+
+bool ushell_complete_argument(char* line, uint8_t size)
+{
+    // the argument being completed begins after the last space
+    char* space = strrchr(line, ' ');
+    if (space == 0)
+        return false;
+    uint8_t argument = space + 1 - line;
+
+    // the cache remains valid, as long as the user only appended to the argument;
+    // an overflowed cache can not be filtered
+    if (completion_valid
+     && !completion_overflow
+     && argument == completion_argument
+     && strncmp(line, completion_line, strlen(completion_line)) == 0)
+    {
+        completion_filter(&line[argument]);
+    }
+    else
+    {
+        completion_valid = completion_fill(line, argument);
+        if (!completion_valid)
+            return false;
+    }
+
+    bool listed = false;
+    uint8_t l = strlen(line);
+    uint8_t typed = l - argument;
+    if (completion_count > 0)
+    {
+        // longest common prefix of all candidates
+        const char* first = completion_cache[0];
+        uint8_t common = strlen(first);
+        for (uint8_t i=1; i<completion_count; i++)
+        {
+            uint8_t j = 0;
+            while (j < common && completion_cache[i][j] == first[j])
+                j++;
+            common = j;
+        }
+
+        if (!completion_overflow && (completion_count == 1 || common > typed))
+        {
+            // extend the line, as far as it fits
+            for (uint8_t j=typed; j<common && l<size-2; j++)
+                line[l++] = first[j];
+            if (completion_count == 1 && l < size-2)
+                line[l++] = ' ';
+            line[l] = '\0';
+        }
+        else
+        {
+            // ambiguous: list the candidates
+            crlf();
+            for (uint8_t i=0; i<completion_count; i++)
+            {
+                write((char*) completion_cache[i]);
+                write("  ");
+            }
+            if (completion_overflow)
+                write("...");
+            crlf();
+            listed = true;
+        }
+    }
+
+    strncpy(completion_line, line, MAX_LENGTH-1);
+    completion_line[MAX_LENGTH-1] = '\0';
+    completion_argument = argument;
+    return listed;
+}
+
+void ushell_completion_reset()
+{
+    completion_valid = false;
+}
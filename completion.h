@@ -0,0 +1,42 @@
+/**
+ * Argument completion
+ * ---------------------------------------------
+ *
+ * Applications may provide a completion callback,
+ * which enumerates candidates for an argument position.
+ * Candidates are cached and filtered as the user keeps typing,
+ * so that the application is asked only once per argument.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_COMPLETION_H
+#define USHELL_COMPLETION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// maximum number of cached candidates
+// (if more candidates match, the application is asked again upon the next TAB)
+#define USHELL_COMPLETION_CACHE_SIZE    32
+
+/**
+ * @brief Complete the argument at the end of a command line
+ *
+ * Extends the line in-place to the longest common prefix of all candidates,
+ * followed by a space, if there is only one candidate.
+ * If the line can not be extended, the candidates are listed.
+ *
+ * @param line: Command line
+ * @param size: Size of the command line buffer
+ * @return true, if candidates were listed, i.e. the prompt needs to be redrawn
+ */
+bool ushell_complete_argument(char* line, uint8_t size);
+
+/**
+ * @brief Discard cached candidates, e.g. after a command was executed
+ */
+void ushell_completion_reset();
+
+#endif // USHELL_COMPLETION_H
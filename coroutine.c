@@ -0,0 +1,183 @@
+/**
+ * Coroutine applications
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "coroutine.h"
+#include "ushell.h"
+
+
+// running coroutines, 0 for unused entries
+ushell_coroutine_t* coroutines[USHELL_COROUTINES];
+
+// coroutine receiving keystrokes
+ushell_coroutine_t* coroutine_foreground = 0;
+
+
+/**
+ * @brief Remove a coroutine from the table of running coroutines
+ */
+void coroutine_end(ushell_coroutine_t* co)
+{
+    for (uint8_t i=0; i<USHELL_COROUTINES; i++)
+        if (coroutines[i] == co)
+            coroutines[i] = 0;
+
+    // return to the prompt
+    if (co == coroutine_foreground)
+    {
+        coroutine_foreground = 0;
+        ushell_release_keystroke_handler();
+    }
+}
+
+/**
+ * @brief Whether the condition a coroutine awaits is met
+ */
+bool coroutine_ready(ushell_coroutine_t* co)
+{
+    switch (co->wait)
+    {
+        case COROUTINE_READY:
+            return true;
+        case COROUTINE_AWAIT_KEY:
+            return co->key_pending;
+        case COROUTINE_SLEEP:
+            return (int32_t) (ushell_uptime_ms() - co->wake) >= 0;
+        default:
+            // lines are completed by the keystroke handler
+            return false;
+    }
+}
+
+/**
+ * @brief Continue a coroutine after its last await
+ */
+void coroutine_resume(ushell_coroutine_t* co)
+{
+    if (co->wait == COROUTINE_AWAIT_KEY)
+        co->key_pending = false;
+    co->wait = COROUTINE_READY;
+
+    if ((*(co->function))(co) == USHELL_COROUTINE_DONE)
+        coroutine_end(co);
+}
+
+/**
+ * @brief Forward keystrokes to the foreground coroutine
+ */
+void coroutine_keystroke_handler(uint32_t key)
+{
+    ushell_coroutine_t* co = coroutine_foreground;
+    if (co == 0)
+        return;
+
+    if (key == KEY_CTRL_C)
+    {
+        writeln("^C");
+        coroutine_end(co);
+        return;
+    }
+
+    if (co->wait != COROUTINE_AWAIT_LINE)
+    {
+        co->key = key;
+        co->key_pending = true;
+        return;
+    }
+
+    // line editing
+    if (key == KEY_ENTER)
+    {
+        crlf();
+        co->key = key;
+        co->wait = COROUTINE_READY;
+    }
+    else if (key == KEY_BACKSPACE)
+    {
+        if (co->length > 0)
+        {
+            co->buffer[--co->length] = '\0';
+            write(ANSI_CURSOR_LEFT(1) " " ANSI_CURSOR_LEFT(1));
+        }
+    }
+    else if (key < 0x100 && is_printable(key) && co->length < co->size-1)
+    {
+        co->buffer[co->length++] = key;
+        co->buffer[co->length] = '\0';
+        writec(key);
+    }
+}
+
+bool ushell_coroutine_start(ushell_coroutine_t* co, ushell_coroutine_function_t function, bool foreground)
+{
+    uint8_t i = 0;
+    while (i < USHELL_COROUTINES && coroutines[i] != 0)
+        i++;
+    if (i >= USHELL_COROUTINES || (foreground && coroutine_foreground != 0))
+        return false;
+
+    co->function = function;
+    co->line = 0;
+    co->wait = COROUTINE_READY;
+    co->key_pending = false;
+    coroutines[i] = co;
+
+    // run until the first await
+    if ((*function)(co) == USHELL_COROUTINE_DONE)
+    {
+        coroutines[i] = 0;
+        return true;
+    }
+
+    if (foreground)
+    {
+        coroutine_foreground = co;
+        ushell_attach_keystroke_handler(&coroutine_keystroke_handler);
+    }
+    return true;
+}
+
+void ushell_coroutine_stop(ushell_coroutine_t* co)
+{
+    coroutine_end(co);
+}
+
+void ushell_coroutine_poll()
+{
+    for (uint8_t i=0; i<USHELL_COROUTINES; i++)
+    {
+        ushell_coroutine_t* co = coroutines[i];
+        if (co != 0 && coroutine_ready(co))
+            coroutine_resume(co);
+    }
+}
+
+bool ushell_coroutine_pending()
+{
+    for (uint8_t i=0; i<USHELL_COROUTINES; i++)
+    {
+        ushell_coroutine_t* co = coroutines[i];
+        if (co != 0 && co->wait != COROUTINE_SLEEP && coroutine_ready(co))
+            return true;
+    }
+    return false;
+}
+
+uint32_t ushell_coroutine_deadline()
+{
+    uint32_t now = ushell_uptime_ms();
+    uint32_t deadline = USHELL_NO_DEADLINE;
+    for (uint8_t i=0; i<USHELL_COROUTINES; i++)
+    {
+        ushell_coroutine_t* co = coroutines[i];
+        if (co == 0 || co->wait != COROUTINE_SLEEP)
+            continue;
+        if (deadline == USHELL_NO_DEADLINE || (int32_t) (co->wake - now) < (int32_t) (deadline - now))
+            deadline = co->wake;
+    }
+    return deadline;
+}
@@ -0,0 +1,174 @@
+/**
+ * Coroutine applications
+ * ---------------------------------------------
+ *
+ * Interactive applications may be written as stackless coroutines
+ * (protothread-style), which await input or time inline
+ * instead of being split into keystroke handler callbacks:
+ *
+ *   typedef struct
+ *   {
+ *       ushell_coroutine_t co;
+ *       uint8_t i;                  // locals must live in the frame
+ *       char name[16];
+ *   } greeter_t;
+ *
+ *   int greeter(ushell_coroutine_t* co)
+ *   {
+ *       greeter_t* g = (greeter_t*) co;
+ *       USHELL_COROUTINE_BEGIN(co);
+ *       write("Name: ");
+ *       ushell_await_line(co, g->name, sizeof(g->name));
+ *       for (g->i=0; g->i<3; g->i++)
+ *       {
+ *           writeln(g->name);
+ *           ushell_sleep_ms(co, 500);
+ *       }
+ *       USHELL_COROUTINE_END(co);
+ *   }
+ *
+ *   int greet(uint8_t argc, char* argv[], ushell_context_t* context)
+ *   {
+ *       greeter_t* g = ushell_alloc(context, sizeof(greeter_t));
+ *       ushell_coroutine_start(&g->co, &greeter, true);
+ *       return USHELL_STATUS_SUCCESS;
+ *   }
+ *
+ * Coroutines are resumed from ushell_poll(). Local variables
+ * do not survive an await, keep them in the frame.
+ * A switch statement must not span an await.
+ *
+ * A foreground coroutine owns the keyboard until it ends
+ * (Ctrl-C terminates it); the prompt returns afterwards.
+ * Background coroutines may only sleep.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_COROUTINE_H
+#define USHELL_COROUTINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// maximum number of coroutines running concurrently
+#define USHELL_COROUTINES   4
+
+// what a coroutine is waiting for
+typedef enum
+{
+    COROUTINE_READY,
+    COROUTINE_AWAIT_KEY,
+    COROUTINE_AWAIT_LINE,
+    COROUTINE_SLEEP,
+} coroutine_wait_t;
+
+// return values of coroutine functions
+#define USHELL_COROUTINE_WAITING    0
+#define USHELL_COROUTINE_DONE       1
+
+typedef struct ushell_coroutine ushell_coroutine_t;
+typedef int (*ushell_coroutine_function_t)(ushell_coroutine_t*);
+
+// coroutine frame
+struct ushell_coroutine
+{
+    ushell_coroutine_function_t function;
+
+    // resume point
+    uint16_t line;
+    coroutine_wait_t wait;
+
+    // key received by ushell_await_key() or which ended ushell_await_line()
+    uint32_t key;
+    bool key_pending;
+
+    // line edited by ushell_await_line()
+    char* buffer;
+    uint8_t size;
+    uint8_t length;
+
+    // end of ushell_sleep_ms()
+    uint32_t wake;
+};
+
+
+#define USHELL_COROUTINE_BEGIN(co) \
+    switch ((co)->line) { case 0:
+
+#define USHELL_COROUTINE_END(co) \
+    } (co)->line = 0; return USHELL_COROUTINE_DONE;
+
+// suspend and resume at the same place, once the condition is met
+#define USHELL_COROUTINE_YIELD(co, condition) \
+    do { \
+        (co)->wait = (condition); \
+        (co)->line = __LINE__; \
+        return USHELL_COROUTINE_WAITING; \
+        case __LINE__: ; \
+    } while (0)
+
+/**
+ * @brief Wait for a keystroke, which is then available in co->key
+ */
+#define ushell_await_key(co) \
+    USHELL_COROUTINE_YIELD(co, COROUTINE_AWAIT_KEY)
+
+/**
+ * @brief Let the user edit a line (with echo), until enter is pressed
+ *
+ * The line is null-terminated.
+ */
+#define ushell_await_line(co, b, s) \
+    do { \
+        (co)->buffer = (b); \
+        (co)->size = (s); \
+        (co)->length = 0; \
+        (co)->buffer[0] = '\0'; \
+        USHELL_COROUTINE_YIELD(co, COROUTINE_AWAIT_LINE); \
+    } while (0)
+
+/**
+ * @brief Suspend for a number of milliseconds
+ */
+#define ushell_sleep_ms(co, ms) \
+    do { \
+        (co)->wake = ushell_uptime_ms() + (ms); \
+        USHELL_COROUTINE_YIELD(co, COROUTINE_SLEEP); \
+    } while (0)
+
+
+/**
+ * @brief Run a coroutine until its first await, then resume it from ushell_poll()
+ *
+ * The frame must remain valid until the coroutine ends,
+ * e.g. static or, for a foreground coroutine, allocated with ushell_alloc().
+ *
+ * @param foreground: Whether the coroutine owns the keyboard;
+ *                    may only be requested by an application being invoked
+ * @return false, if USHELL_COROUTINES are already running
+ */
+bool ushell_coroutine_start(ushell_coroutine_t* co, ushell_coroutine_function_t function, bool foreground);
+
+/**
+ * @brief Terminate a coroutine
+ */
+void ushell_coroutine_stop(ushell_coroutine_t* co);
+
+/**
+ * @brief Resume coroutines, whose condition is met; invoked by ushell_poll()
+ */
+void ushell_coroutine_poll();
+
+/**
+ * @brief Whether a coroutine can be resumed immediately
+ */
+bool ushell_coroutine_pending();
+
+/**
+ * @brief Earliest end of a sleeping coroutine or USHELL_NO_DEADLINE
+ */
+uint32_t ushell_coroutine_deadline();
+
+#endif // USHELL_COROUTINE_H
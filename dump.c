@@ -0,0 +1,120 @@
+/**
+ * Built-in memory dump command
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "dump.h"
+#include "ushell.h"
+#include "syslog.h"
+
+
+#define ADDRESS_DIGITS  (2*sizeof(uintptr_t))
+
+// address, hexadecimal and ASCII columns plus line break
+#define LINE_LENGTH     (ADDRESS_DIGITS + 2 + 16*3 + 1 + 1 + 16 + 1 + 2)
+
+
+/**
+ * @brief Format one line of up to 16 bytes
+ * @return Number of characters written
+ */
+uint8_t dump_line(char* line, const uint8_t* p, uint8_t n)
+{
+    char* s = line;
+
+    // address, most significant byte first
+    uintptr_t address = (uintptr_t) p;
+    uint8_t bytes[sizeof(uintptr_t)];
+    for (uint8_t i=0; i<sizeof(uintptr_t); i++)
+        bytes[i] = address >> (8*(sizeof(uintptr_t)-1-i));
+    hex_encode(bytes, sizeof(uintptr_t), s);
+    s += ADDRESS_DIGITS;
+    *s++ = ' ';
+    *s++ = ' ';
+
+    // hexadecimal column
+    char hex[2*16+1];
+    hex_encode(p, n, hex);
+    for (uint8_t i=0; i<16; i++)
+    {
+        if (i < n)
+        {
+            s[0] = hex[2*i];
+            s[1] = hex[2*i+1];
+        }
+        else
+        {
+            s[0] = ' ';
+            s[1] = ' ';
+        }
+        s[2] = ' ';
+        s += 3;
+        if (i == 7)
+            *s++ = ' ';
+    }
+
+    // ASCII column
+    *s++ = '|';
+    for (uint8_t i=0; i<n; i++)
+        *s++ = is_printable(p[i]) ? p[i] : '.';
+    *s++ = '|';
+    *s++ = '\r';
+    *s++ = '\n';
+
+    return s - line;
+}
+
+int ushell_md(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    uintptr_t address;
+    uintptr_t length = USHELL_DUMP_DEFAULT_LENGTH;
+
+    if (argc < 2 || argc > 3 || !hex2uint(argv[1], &address))
+    {
+        log_error("Usage: md <address> [length]");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    if (argc == 3)
+    {
+        bool valid;
+        if (strncmp(argv[2], "0x", 2) == 0)
+        {
+            valid = hex2uint(argv[2], &length);
+        }
+        else
+        {
+            uint32_t l = 0;
+            valid = str2uint(argv[2], &l);
+            length = l;
+        }
+
+        if (!valid)
+        {
+            log_error("Invalid length");
+            return USHELL_STATUS_FAILURE;
+        }
+    }
+
+    const uint8_t* p = (const uint8_t*) address;
+    char chunk[USHELL_DUMP_CHUNK_LINES*LINE_LENGTH + 1];
+
+    while (length > 0)
+    {
+        // format several lines, then output them at once
+        uint16_t l = 0;
+        for (uint8_t i=0; i<USHELL_DUMP_CHUNK_LINES && length > 0; i++)
+        {
+            uint8_t n = (length < 16) ? length : 16;
+            l += dump_line(&chunk[l], p, n);
+            p += n;
+            length -= n;
+        }
+        chunk[l] = '\0';
+        write(chunk);
+    }
+    return USHELL_STATUS_SUCCESS;
+}
@@ -0,0 +1,29 @@
+/**
+ * Built-in memory dump command
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_DUMP_H
+#define USHELL_DUMP_H
+
+#include <stdint.h>
+#include "scratch.h"
+
+// number of bytes to dump, if no length is specified
+#define USHELL_DUMP_DEFAULT_LENGTH  256
+
+// number of lines formatted before they are output at once
+#define USHELL_DUMP_CHUNK_LINES     4
+
+/**
+ * @brief Built-in command: md <address> [length]
+ *
+ * Outputs memory as hexadecimal and ASCII columns, 16 bytes per line.
+ * The address is hexadecimal, the length decimal or hexadecimal (0x prefix).
+ */
+int ushell_md(uint8_t argc, char* argv[], ushell_context_t* context);
+
+#endif // USHELL_DUMP_H
@@ -7,6 +7,10 @@
 
 #include "helper.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 inline char char2lower(char c)
 {
     return c >='A' && c <= 'Z' ? c|0x60 : c;
@@ -74,6 +78,53 @@ void uint2str(uint32_t w, char* buffer)
     *buffer = 0;
 }
 
+bool str2uint(char* s, uint32_t* value)
+{
+    if (*s == '\0')
+        return false;
+
+    uint32_t v = 0;
+    while (*s != '\0')
+    {
+        if (*s < '0' || *s > '9')
+            return false;
+        v = v*10 + (*s - '0');
+        s++;
+    }
+
+    *value = v;
+    return true;
+}
+
+bool str2duration(char* s, uint32_t* milliseconds)
+{
+    // split numeric part from unit suffix
+    char number[11];
+    uint8_t i = 0;
+    while (s[i] >= '0' && s[i] <= '9')
+    {
+        if (i >= sizeof(number)-1)
+            return false;
+        number[i] = s[i];
+        i++;
+    }
+    number[i] = '\0';
+
+    uint32_t v;
+    if (!str2uint(number, &v))
+        return false;
+
+    char* unit = s+i;
+    if (strcmp(unit, "ms") == 0)
+        *milliseconds = v;
+    else if (strcmp(unit, "s") == 0 || *unit == '\0')
+        *milliseconds = v*1000;
+    else
+        return false;
+
+    return true;
+}
+
 void float2str(float* f, char* buffer)
 {
     uint32_t d = (uint32_t) *f;
@@ -90,34 +141,37 @@ void float2str(float* f, char* buffer)
     *buffer = 0;
 }
 
+// binary representation of all nibbles
+const char nibble_binary[16][4] =
+{
+    "0000", "0001", "0010", "0011", "0100", "0101", "0110", "0111",
+    "1000", "1001", "1010", "1011", "1100", "1101", "1110", "1111",
+};
+
+// hexadecimal representation of all bytes
+#define HEX_ROW(h)  h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+                    h "8" h "9" h "A" h "B" h "C" h "D" h "E" h "F"
+const char byte_hex[512+1] =
+    HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+    HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+    HEX_ROW("8") HEX_ROW("9") HEX_ROW("A") HEX_ROW("B")
+    HEX_ROW("C") HEX_ROW("D") HEX_ROW("E") HEX_ROW("F");
+
 inline void byte2binary(uint32_t value, char buffer[])
 {
-    // 32 bits
-    for (int i=7; i>=0; i--)
-    {
-        // extract LSB
-        uint8_t bit = value & 0x00000001;
-        // convert to ASCII '0' or '1'
-        buffer[i] = 0x30 + bit;
-        // shift right to get next higher bit
-        value >>= 1;
-    }
+    memcpy(&buffer[0], nibble_binary[(value >> 4) & 0x0F], 4);
+    memcpy(&buffer[4], nibble_binary[value & 0x0F], 4);
     // append string terminator
     buffer[8] = '\0';
 }
 
-
 inline void word2binary(uint32_t value, char buffer[])
 {
-    // 32 bits
-    for (int i=31; i>=0; i--)
+    // 32 bits, most significant nibble first
+    for (int i=7; i>=0; i--)
     {
-        // extract LSB
-        uint8_t bit = value & 0x00000001;
-        // convert to ASCII '0' or '1'
-        buffer[i] = 0x30 + bit;
-        // shift right to get next higher bit
-        value >>= 1;
+        memcpy(&buffer[i*4], nibble_binary[value & 0x0F], 4);
+        value >>= 4;
     }
     // append string terminator
     buffer[32] = '\0';
@@ -138,8 +192,7 @@ inline void byte2hex(uint8_t b, char buffer[], bool prefix)
     }
 
     // hex
-    buffer[0] = nibble2hex(b >> 4);
-    buffer[1] = nibble2hex(b & 0x0F);
+    memcpy(buffer, &byte_hex[b*2], 2);
 
     // append string terminator
     buffer[2] = '\0';
@@ -154,15 +207,201 @@ inline void word2hex(uint32_t w, char buffer[], bool prefix)
         buffer += 2;
     }
 
-    byte2hex(w >> 24, buffer, false);
-    buffer += 2;
-    byte2hex((w >> 16) & 0xFF, buffer, false);
-    buffer += 2;
-    byte2hex((w >> 8) & 0xFF, buffer, false);
-    buffer += 2;
-    byte2hex(w & 0xff, buffer, false);
-    buffer += 2;
-    *buffer = 0;
+    memcpy(&buffer[0], &byte_hex[(w >> 24)*2], 2);
+    memcpy(&buffer[2], &byte_hex[((w >> 16) & 0xFF)*2], 2);
+    memcpy(&buffer[4], &byte_hex[((w >> 8) & 0xFF)*2], 2);
+    memcpy(&buffer[6], &byte_hex[(w & 0xFF)*2], 2);
+    buffer[8] = '\0';
+}
+
+void hex_encode(const void* data, size_t length, char* buffer)
+{
+    const uint8_t* p = (const uint8_t*) data;
+
+    #ifdef __SSE2__
+    // 16 bytes at a time: split into nibbles, convert and interleave
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i letter_offset = _mm_set1_epi8('A'-'0'-10);
+    while (length >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letter_offset));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letter_offset));
+        _mm_storeu_si128((__m128i*) &buffer[0], _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*) &buffer[16], _mm_unpackhi_epi8(hi, lo));
+        p += 16;
+        buffer += 32;
+        length -= 16;
+    }
+    #endif
+
+    while (length > 0)
+    {
+        memcpy(buffer, &byte_hex[*p*2], 2);
+        p++;
+        buffer += 2;
+        length--;
+    }
+
+    // append string terminator
+    *buffer = '\0';
+}
+
+void binary_encode(const void* data, size_t length, char* buffer)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    while (length > 0)
+    {
+        memcpy(&buffer[0], nibble_binary[*p >> 4], 4);
+        memcpy(&buffer[4], nibble_binary[*p & 0x0F], 4);
+        p++;
+        buffer += 8;
+        length--;
+    }
+
+    // append string terminator
+    *buffer = '\0';
+}
+
+bool hex2uint(char* s, uintptr_t* value)
+{
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+        s += 2;
+    if (*s == '\0')
+        return false;
+
+    uintptr_t v = 0;
+    while (*s != '\0')
+    {
+        char c = char2lower(*s);
+        if (c >= '0' && c <= '9')
+            v = (v << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            v = (v << 4) | (c - 'a' + 10);
+        else
+            return false;
+        s++;
+    }
+
+    *value = v;
+    return true;
+}
+
+// CRC-16/XMODEM of all nibbles
+const uint16_t crc16_nibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t crc16(uint16_t crc, const void* data, size_t length)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    while (length > 0)
+    {
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*p >> 4)];
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*p & 0x0F)];
+        p++;
+        length--;
+    }
+    return crc;
+}
+
+bool edit_pattern(edit_pattern_t* p, const char* pattern)
+{
+    uint8_t m = strlen(pattern);
+    if (m > EDIT_PATTERN_MAX_LENGTH)
+        return false;
+
+    // non-ASCII characters match nothing
+    memset(p->peq, 0, sizeof(p->peq));
+    for (uint8_t i=0; i<m; i++)
+        if ((uint8_t) pattern[i] < 128)
+            p->peq[(uint8_t) pattern[i]] |= (uint32_t) 1 << i;
+    p->length = m;
+    return true;
+}
+
+uint8_t edit_distance(const edit_pattern_t* p, const char* s, uint8_t max)
+{
+    uint8_t m = p->length;
+    uint8_t n = strlen(s);
+
+    // the distance is at least the difference in length
+    uint8_t difference = (n > m) ? n - m : m - n;
+    if (difference > max)
+        return max+1;
+    if (m == 0)
+        return n;
+
+    // vertical deltas of the current column, +1 and -1 respectively
+    uint32_t pv = ~(uint32_t) 0;
+    uint32_t mv = 0;
+    uint32_t last = (uint32_t) 1 << (m-1);
+    uint8_t score = m;
+
+    for (uint8_t j=0; j<n; j++)
+    {
+        uint32_t eq = ((uint8_t) s[j] < 128) ? p->peq[(uint8_t) s[j]] : 0;
+        uint32_t xv = eq | mv;
+        uint32_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint32_t ph = mv | ~(xh | pv);
+        uint32_t mh = pv & xh;
+
+        if (ph & last)
+            score++;
+        else if (mh & last)
+            score--;
+
+        // the first row increases by one per character
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        // each remaining character decreases the distance by one at most
+        if (score > max + (n-1-j))
+            return max+1;
+    }
+
+    return score;
+}
+
+bool search_pattern(search_pattern_t* p, const char* pattern)
+{
+    size_t m = strlen(pattern);
+    if (m > SEARCH_PATTERN_MAX_LENGTH)
+        return false;
+
+    memset(p->shift, m, sizeof(p->shift));
+    for (uint8_t i=0; i+1<m; i++)
+        p->shift[(uint8_t) pattern[i]] = m-1-i;
+    p->bytes = (const uint8_t*) pattern;
+    p->length = m;
+    return true;
+}
+
+const uint8_t* search(const search_pattern_t* p, const uint8_t* data, size_t length)
+{
+    uint8_t m = p->length;
+    if (m == 0)
+        return data;
+    uint8_t last = p->bytes[m-1];
+
+    size_t i = 0;
+    while (length >= m && i <= length - m)
+    {
+        // compare the window's last byte first, it also determines the skip
+        uint8_t c = data[i+m-1];
+        if (c == last && memcmp(&data[i], p->bytes, m-1) == 0)
+            return &data[i];
+        i += p->shift[c];
+    }
+    return 0;
 }
 
 inline bool beginning_matches(char* user_input, char* complete_command)
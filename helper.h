@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "ushell.h"
@@ -44,6 +45,22 @@ void float2str(float*, char*);
  */
 void uint2str(uint32_t, char*);
 
+/**
+ * @brief Parse a decimal string into an unsigned integer
+ *
+ * @return false, if the string is empty or contains non-digit characters
+ */
+bool str2uint(char* s, uint32_t* value);
+
+/**
+ * @brief Parse a duration with optional unit suffix into milliseconds
+ *
+ * Accepts e.g. "250ms", "2s" or "2" (seconds).
+ *
+ * @return false, if the string is not a valid duration
+ */
+bool str2duration(char* s, uint32_t* milliseconds);
+
 /**
  * @brief Generate a binary representation of an 8-bit integer
  *
@@ -85,6 +102,103 @@ void byte2hex(uint8_t b, char buffer[], bool prefix);
  */
 void word2hex(uint32_t w, char buffer[], bool prefix);
 
+/**
+ * @brief Generate a hexadecimal representation of a span of bytes
+ *
+ * Uses SIMD instructions, where available.
+ *
+ * @param data: Bytes to represent
+ * @param length: Number of bytes
+ * @param buffer: Pointer to at least 2*length+1 bytes
+ */
+void hex_encode(const void* data, size_t length, char* buffer);
+
+/**
+ * @brief Generate a binary representation of a span of bytes
+ *
+ * @param data: Bytes to represent
+ * @param length: Number of bytes
+ * @param buffer: Pointer to at least 8*length+1 bytes
+ */
+void binary_encode(const void* data, size_t length, char* buffer);
+
+/**
+ * @brief Parse a hexadecimal string with optional 0x prefix
+ *
+ * @return false, if the string contains non-hexadecimal characters
+ */
+bool hex2uint(char* s, uintptr_t* value);
+
+/**
+ * @brief Update a CRC-16/XMODEM (polynomial 0x1021) with a span of bytes
+ *
+ * @param crc: 0 initially, the previous result to continue
+ */
+uint16_t crc16(uint16_t crc, const void* data, size_t length);
+
+// maximum pattern length supported by edit_distance()
+#define EDIT_PATTERN_MAX_LENGTH     32
+
+/*
+ * Pattern preprocessed for edit_distance():
+ * for each ASCII character one bit per position, at which it occurs
+ */
+typedef struct
+{
+    uint32_t peq[128];
+    uint8_t length;
+} edit_pattern_t;
+
+/**
+ * @brief Preprocess a pattern for edit_distance()
+ *
+ * @return false, if the pattern is longer than EDIT_PATTERN_MAX_LENGTH
+ */
+bool edit_pattern(edit_pattern_t* p, const char* pattern);
+
+/**
+ * @brief Levenshtein distance between a pattern and a string
+ *
+ * Bit-parallel (Myers/Hyyrö), i.e. one step per character of the string.
+ *
+ * @param max: Distances greater than this may be reported as max+1
+ */
+uint8_t edit_distance(const edit_pattern_t* p, const char* s, uint8_t max);
+
+// maximum pattern length supported by search()
+#define SEARCH_PATTERN_MAX_LENGTH   255
+
+/*
+ * Pattern preprocessed for search():
+ * for each byte value the distance of its last occurrence
+ * (except at the last position) to the pattern's end
+ */
+typedef struct
+{
+    uint8_t shift[256];
+    const uint8_t* bytes;
+    uint8_t length;
+} search_pattern_t;
+
+/**
+ * @brief Preprocess a pattern for search()
+ *
+ * The pattern must remain valid while it is searched for.
+ *
+ * @return false, if the pattern is longer than SEARCH_PATTERN_MAX_LENGTH
+ */
+bool search_pattern(search_pattern_t* p, const char* pattern);
+
+/**
+ * @brief Find the first occurrence of a pattern in a span of bytes
+ *
+ * Boyer-Moore-Horspool, i.e. skips ahead by up to the pattern's length
+ * per comparison.
+ *
+ * @return Pointer to the occurrence or 0, if there is none
+ */
+const uint8_t* search(const search_pattern_t* p, const uint8_t* data, size_t length);
+
 /**
  * @brief Check, whether the user input matches the beginning of a command (string)
  */
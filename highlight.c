@@ -0,0 +1,332 @@
+/**
+ * Command highlighting
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "highlight.h"
+#include "ushell.h"
+#include "alias.h"
+
+#ifdef USHELL_HIGHLIGHT
+
+// ushell.c
+extern const ushell_app_t ushell_builtins[];
+extern const uint8_t ushell_builtin_count;
+extern ushell_app_list_t* ushell_app_list;
+extern bool ushell_echo;
+uint16_t registry_count();
+
+// alias.c
+extern uint8_t alias_arena[];
+extern uint16_t alias_arena_used;
+extern uint8_t alias_generation;
+
+// commands beginning with the characters matched so far
+typedef struct
+{
+    // range of the registry, which is sorted by name
+    uint16_t first;
+    uint16_t last;
+
+    // one bit per built-in command, command list entry and alias
+    uint32_t builtins;
+    uint32_t list;
+    uint32_t aliases;
+} highlight_cursor_t;
+
+// one cursor per matched character, the first one matching everything
+highlight_cursor_t highlight_cursors[USHELL_HIGHLIGHT_DEPTH+1];
+
+// length of the command, i.e. the characters before the first space
+uint8_t highlight_depth = 0;
+
+// whether the command contains '=', i.e. is a variable assignment
+bool highlight_assignment = false;
+
+highlight_t highlight_state = HIGHLIGHT_UNKNOWN;
+
+// arena offsets of the first 32 aliases
+uint16_t highlight_alias_offset[32];
+uint8_t highlight_alias_count = 0;
+uint8_t highlight_alias_generation = 0;
+
+#define highlight_alias_name(i)     ((char*) &alias_arena[highlight_alias_offset[i]+1])
+
+
+/**
+ * @brief First registry entry in a range, whose character at a position is not below c
+ */
+uint16_t highlight_bound(uint16_t first, uint16_t last, uint8_t position, uint8_t c)
+{
+    while (first < last)
+    {
+        uint16_t middle = first + (last - first) / 2;
+        if ((uint8_t) __start_ushell_commands[middle].name[position] < c)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first;
+}
+
+/**
+ * @brief Whether a command list entry is a command (rather than a help text)
+ */
+bool highlight_listed(const ushell_app_t* app)
+{
+    return app->name != 0 && (app->function != 0 || app->children != 0);
+}
+
+/**
+ * @brief Index the aliases, if they changed since the last command line
+ */
+void highlight_index_aliases()
+{
+    if (highlight_alias_generation == alias_generation)
+        return;
+    highlight_alias_generation = alias_generation;
+
+    highlight_alias_count = 0;
+    for (uint16_t offset=0; offset<alias_arena_used && highlight_alias_count<32; offset+=alias_arena[offset])
+        highlight_alias_offset[highlight_alias_count++] = offset;
+}
+
+/**
+ * @brief Cursor matching all commands
+ */
+void highlight_begin(highlight_cursor_t* cursor)
+{
+    highlight_index_aliases();
+    cursor->first = 0;
+    cursor->last = registry_count();
+    cursor->builtins = (ushell_builtin_count < 32) ? ((uint32_t) 1 << ushell_builtin_count) - 1 : 0xFFFFFFFF;
+    cursor->list = 0;
+    for (uint8_t i=0; ushell_app_list != 0 && i<ushell_app_list->count && i<32; i++)
+        if (highlight_listed(&ushell_app_list->apps[i]))
+            cursor->list |= (uint32_t) 1 << i;
+    cursor->aliases = (highlight_alias_count < 32) ? ((uint32_t) 1 << highlight_alias_count) - 1 : 0xFFFFFFFF;
+}
+
+/**
+ * @brief Narrow a cursor down to the commands continuing with a character
+ * @param position: Number of characters matched by the cursor
+ */
+void highlight_advance(const highlight_cursor_t* from, highlight_cursor_t* to, uint8_t position, uint8_t c)
+{
+    // registry entries in range share all characters before position
+    uint16_t first = highlight_bound(from->first, from->last, position, c);
+    uint16_t last = (c < 0xFF) ? highlight_bound(first, from->last, position, c+1) : from->last;
+
+    uint32_t builtins = 0;
+    for (uint32_t m=from->builtins; m != 0; m &= m-1)
+    {
+        uint8_t i = __builtin_ctz(m);
+        if ((uint8_t) ushell_builtins[i].name[position] == c)
+            builtins |= (uint32_t) 1 << i;
+    }
+
+    uint32_t list = 0;
+    for (uint32_t m=from->list; m != 0; m &= m-1)
+    {
+        uint8_t i = __builtin_ctz(m);
+        if ((uint8_t) ushell_app_list->apps[i].name[position] == c)
+            list |= (uint32_t) 1 << i;
+    }
+
+    uint32_t aliases = 0;
+    for (uint32_t m=from->aliases; m != 0; m &= m-1)
+    {
+        uint8_t i = __builtin_ctz(m);
+        if ((uint8_t) highlight_alias_name(i)[position] == c)
+            aliases |= (uint32_t) 1 << i;
+    }
+
+    to->first = first;
+    to->last = last;
+    to->builtins = builtins;
+    to->list = list;
+    to->aliases = aliases;
+}
+
+/**
+ * @brief Whether a cursor matches a command exactly
+ * @param position: Number of characters matched by the cursor
+ */
+bool highlight_exact(const highlight_cursor_t* cursor, uint8_t position)
+{
+    // an exact match sorts first
+    if (cursor->first < cursor->last
+     && __start_ushell_commands[cursor->first].name[position] == '\0')
+        return true;
+
+    for (uint32_t m=cursor->builtins; m != 0; m &= m-1)
+        if (ushell_builtins[__builtin_ctz(m)].name[position] == '\0')
+            return true;
+
+    for (uint32_t m=cursor->list; m != 0; m &= m-1)
+        if (ushell_app_list->apps[__builtin_ctz(m)].name[position] == '\0')
+            return true;
+
+    for (uint32_t m=cursor->aliases; m != 0; m &= m-1)
+        if (highlight_alias_name(__builtin_ctz(m))[position] == '\0')
+            return true;
+
+    return false;
+}
+
+/**
+ * @brief Cursor for the command matched so far
+ */
+highlight_cursor_t* highlight_cursor()
+{
+    return &highlight_cursors[(highlight_depth < USHELL_HIGHLIGHT_DEPTH) ? highlight_depth : USHELL_HIGHLIGHT_DEPTH];
+}
+
+/**
+ * @brief Classify the command matched so far
+ */
+highlight_t highlight_classify()
+{
+    highlight_cursor_t* cursor = highlight_cursor();
+    if (highlight_exact(cursor, highlight_depth) || highlight_assignment)
+        return HIGHLIGHT_COMMAND;
+
+    if (cursor->first < cursor->last
+     || cursor->builtins != 0
+     || cursor->list != 0
+     || cursor->aliases != 0)
+        return HIGHLIGHT_PREFIX;
+
+    return HIGHLIGHT_UNKNOWN;
+}
+
+/**
+ * @brief Extend the command by one character
+ */
+void highlight_push(char c)
+{
+    // beyond the stack, the last cursor is narrowed in-place
+    highlight_cursor_t* from = highlight_cursor();
+    highlight_cursor_t* to = (highlight_depth < USHELL_HIGHLIGHT_DEPTH) ? from+1 : from;
+    highlight_advance(from, to, highlight_depth, c);
+    highlight_depth++;
+    if (c == '=')
+        highlight_assignment = true;
+}
+
+/**
+ * @brief Move the terminal cursor to the left
+ */
+void highlight_cursor_left(uint8_t columns)
+{
+    if (columns == 0)
+        return;
+    char buffer[11];
+    uint2str(columns, buffer);
+    write(ANSI_ESC "[");
+    write(buffer);
+    writec('D');
+}
+
+/**
+ * @brief Output part of the command in its colour
+ */
+void highlight_output(char* s, uint8_t length)
+{
+    switch (highlight_state)
+    {
+        case HIGHLIGHT_COMMAND:
+            write(USHELL_HIGHLIGHT_COMMAND);
+            break;
+        case HIGHLIGHT_PREFIX:
+            write(USHELL_HIGHLIGHT_PREFIX);
+            break;
+        default:
+            write(USHELL_HIGHLIGHT_UNKNOWN);
+            break;
+    }
+    for (uint8_t i=0; i<length; i++)
+        writec(s[i]);
+    write(ANSI_RESET);
+}
+
+void ushell_highlight_line(char* line)
+{
+    highlight_begin(&highlight_cursors[0]);
+    highlight_depth = 0;
+    highlight_assignment = false;
+    while (line[highlight_depth] != '\0' && line[highlight_depth] != ' ')
+        highlight_push(line[highlight_depth]);
+    highlight_state = highlight_classify();
+}
+
+void ushell_highlight_append(char* line, uint8_t length)
+{
+    char c = line[length-1];
+
+    // characters after the command are echoed as they are
+    if (length-1 != highlight_depth || c == ' ')
+    {
+        if (ushell_echo)
+            writec(c);
+        return;
+    }
+
+    highlight_t previous = highlight_state;
+    highlight_push(c);
+    highlight_state = highlight_classify();
+    if (!ushell_echo)
+        return;
+
+    if (highlight_state == previous)
+    {
+        highlight_output(&c, 1);
+        return;
+    }
+
+    // recolour the whole command
+    highlight_cursor_left(highlight_depth-1);
+    highlight_output(line, highlight_depth);
+}
+
+void ushell_highlight_erase(char* line, uint8_t length)
+{
+    if (length >= highlight_depth)
+        return;
+
+    highlight_t previous = highlight_state;
+    if (highlight_depth > USHELL_HIGHLIGHT_DEPTH)
+    {
+        // the cursor was narrowed in-place
+        ushell_highlight_line(line);
+    }
+    else
+    {
+        highlight_depth--;
+        highlight_assignment = memchr(line, '=', length) != 0;
+        highlight_state = highlight_classify();
+    }
+
+    if (highlight_state != previous && ushell_echo && length > 0)
+    {
+        highlight_cursor_left(length);
+        highlight_output(line, length);
+    }
+}
+
+void ushell_highlight_write(char* line)
+{
+    if (highlight_depth > 0)
+        highlight_output(line, highlight_depth);
+    write(&line[highlight_depth]);
+}
+
+highlight_t ushell_highlight_state()
+{
+    return highlight_state;
+}
+
+#endif // USHELL_HIGHLIGHT
@@ -0,0 +1,80 @@
+/**
+ * Command highlighting
+ * ---------------------------------------------
+ *
+ * While the user types, the command (i.e. the first word of the line)
+ * is coloured according to whether it names a known command or alias,
+ * begins one or matches nothing, so that typos are caught before hitting enter.
+ *
+ * Matching is incremental: A cursor into the (sorted) command registry
+ * is narrowed by one binary search per typed character and
+ * rewound from a stack upon backspace, so that the command table
+ * is not rescanned on every keystroke.
+ * Built-in commands, command list entries and aliases are narrowed
+ * as bitmasks; only the first 32 of each are highlighted.
+ * The aliases are indexed again at the beginning of a command line,
+ * once they changed.
+ * Only the command is redrawn, when its colour changes.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_HIGHLIGHT_H
+#define USHELL_HIGHLIGHT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// if enabled, the command being typed is highlighted
+#define USHELL_HIGHLIGHT
+
+// number of characters, for which matcher states are kept to rewind upon backspace;
+// longer commands are matched again from the beginning
+#define USHELL_HIGHLIGHT_DEPTH      16
+
+// colours of a known command, the beginning of one and anything else
+#define USHELL_HIGHLIGHT_COMMAND    ANSI_FG_GREEN
+#define USHELL_HIGHLIGHT_PREFIX     ANSI_FG_YELLOW
+#define USHELL_HIGHLIGHT_UNKNOWN    ANSI_FG_RED
+
+typedef enum
+{
+    HIGHLIGHT_UNKNOWN,
+    HIGHLIGHT_PREFIX,
+    HIGHLIGHT_COMMAND,
+} highlight_t;
+
+/**
+ * @brief Match a command line, which was replaced as a whole (e.g. from history)
+ *
+ * Nothing is output.
+ */
+void ushell_highlight_line(char* line);
+
+/**
+ * @brief Match and echo the character appended to the command line
+ * @param length: Length of the command line including the new character
+ */
+void ushell_highlight_append(char* line, uint8_t length);
+
+/**
+ * @brief Rewind after the last character was removed from the command line
+ *
+ * The character must already be erased on the terminal.
+ *
+ * @param length: Length of the command line after removal
+ */
+void ushell_highlight_erase(char* line, uint8_t length);
+
+/**
+ * @brief Output a command line with the command highlighted
+ */
+void ushell_highlight_write(char* line);
+
+/**
+ * @brief Whether the command typed so far is known, begins a known one or neither
+ */
+highlight_t ushell_highlight_state();
+
+#endif // USHELL_HIGHLIGHT_H
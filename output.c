@@ -0,0 +1,472 @@
+/**
+ * Buffered shell output with flow control
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "output.h"
+#include "ushell.h"
+#include "scrollback.h"
+#include "tasks.h"
+#include "receive.h"
+
+
+extern keystroke_handler_t current_keystroke_handler;
+extern bool prompt_redraw_pending;
+
+
+#define OUTPUT_MASK     (USHELL_OUTPUT_BUFFER_SIZE-1)
+
+// transmit buffer
+uint8_t output_buffer[USHELL_OUTPUT_BUFFER_SIZE];
+
+// free-running positions of the next byte to queue and to transmit
+volatile uint16_t output_head = 0;
+volatile uint16_t output_tail = 0;
+
+// set upon XOFF, cleared upon XON
+volatile bool output_paused = false;
+
+output_policy_t output_policy = OUTPUT_POLICY_DROP_OLDEST;
+output_statistics_t output_statistics;
+
+// handler capturing the shell's output, if any
+output_handler_t current_output_handler = 0;
+
+// completely queued log lines, which have not begun transmission yet, oldest first
+typedef struct
+{
+    uint16_t start;
+    uint16_t end;
+} output_log_line_t;
+
+output_log_line_t output_log_lines[USHELL_OUTPUT_MAX_LOG_LINES];
+uint8_t output_log_line_count = 0;
+
+// state of the log line currently being written
+bool output_inside_log = false;
+bool output_log_discarding = false;
+bool output_log_truncated = false;
+bool output_log_frame = false;
+uint16_t output_log_start;
+
+// interactive bytes dropped while the link was stalled, not reported yet
+uint32_t output_lost = 0;
+
+#define output_used()   ((uint16_t) (output_head - output_tail))
+#define output_free()   (USHELL_OUTPUT_BUFFER_SIZE - output_used())
+
+
+// fallback routines, if no other methods are implemented
+__attribute__((weak)) bool terminal_output_ready()
+{
+    return true;
+}
+
+__attribute__((weak)) uint16_t terminal_output_buffer(uint8_t* data, uint16_t length)
+{
+    for (uint16_t i=0; i<length; i++)
+    {
+        terminal_output_char(data[i]);
+    }
+    return length;
+}
+
+/**
+ * @brief Report interactive output dropped while the link was stalled,
+ *        once there is room again
+ */
+void output_report_lost()
+{
+    // not within a log line or a transfer, and only as a whole
+    if (output_lost == 0
+     || output_inside_log
+     || ushell_receiving()
+     || ushell_output_stalled()
+     || output_free() < 40)
+        return;
+
+    char buffer[40] = "\r\n(";
+    uint2str(output_lost, &buffer[3]);
+    strcat(buffer, " bytes of output lost)\r\n");
+    for (char* s=buffer; *s != '\0'; s++)
+        output_buffer[output_head++ & OUTPUT_MASK] = *s;
+    output_lost = 0;
+
+    // the interrupted command line is shown again
+    if (current_keystroke_handler == 0)
+        prompt_redraw_pending = true;
+}
+
+void ushell_output_flush()
+{
+    output_report_lost();
+
+    while (output_head != output_tail
+        && !output_paused
+        && terminal_output_ready())
+    {
+        // transmit the contiguous part of the queued data
+        uint16_t offset = output_tail & OUTPUT_MASK;
+        uint16_t n = output_used();
+        if (n > USHELL_OUTPUT_BUFFER_SIZE - offset)
+            n = USHELL_OUTPUT_BUFFER_SIZE - offset;
+
+        uint16_t sent = terminal_output_buffer(&output_buffer[offset], n);
+        output_tail += sent;
+        if (sent == 0)
+            break;
+    }
+}
+
+/**
+ * @brief Wait until the transmit buffer has space for at least one byte
+ * @return false, if the link does not accept data, i.e. waiting might never end
+ */
+bool output_wait()
+{
+    while (output_free() == 0)
+    {
+        if (ushell_output_stalled())
+            return false;
+        ushell_output_flush();
+    }
+    return true;
+}
+
+/**
+ * @brief Stop tracking log lines, which already begun transmission
+ */
+void output_forget_transmitted_log_lines()
+{
+    uint8_t n = 0;
+    while (n < output_log_line_count
+        && (int16_t) (output_log_lines[n].start - output_tail) < 0)
+        n++;
+
+    if (n > 0)
+    {
+        output_log_line_count -= n;
+        memmove(output_log_lines, &output_log_lines[n], output_log_line_count*sizeof(output_log_line_t));
+    }
+}
+
+/**
+ * @brief Remove the oldest queued log line from the transmit buffer
+ * @return false, if there is no such line
+ */
+bool output_drop_oldest_log_line()
+{
+    output_forget_transmitted_log_lines();
+    if (output_log_line_count == 0)
+        return false;
+
+    uint16_t start = output_log_lines[0].start;
+    uint16_t end = output_log_lines[0].end;
+    uint16_t len = end - start;
+
+    // move all following data to close the gap
+    for (uint16_t p=end; p!=output_head; p++)
+        output_buffer[(uint16_t) (p-len) & OUTPUT_MASK] = output_buffer[p & OUTPUT_MASK];
+    output_head -= len;
+
+    output_log_line_count--;
+    for (uint8_t i=0; i<output_log_line_count; i++)
+    {
+        output_log_lines[i].start = output_log_lines[i+1].start - len;
+        output_log_lines[i].end = output_log_lines[i+1].end - len;
+    }
+    if (output_inside_log)
+        output_log_start -= len;
+
+    output_statistics.dropped_bytes += len;
+    output_statistics.dropped_lines++;
+    return true;
+}
+
+/**
+ * @brief Discard the log line currently being written
+ */
+void output_discard_log_line()
+{
+    output_log_discarding = true;
+    output_statistics.dropped_lines++;
+
+    if ((int16_t) (output_log_start - output_tail) >= 0)
+    {
+        // nothing transmitted yet: remove the line completely
+        output_statistics.dropped_bytes += (uint16_t) (output_head - output_log_start);
+        output_head = output_log_start;
+    }
+    else
+    {
+        // the line must at least be terminated,
+        // the part not handed to the terminal yet makes room for that
+        output_statistics.dropped_bytes += (uint16_t) (output_head - output_tail);
+        output_head = output_tail;
+        output_log_truncated = true;
+    }
+}
+
+/**
+ * @brief Append a byte to the transmit buffer
+ */
+void output_enqueue(uint8_t c)
+{
+    if (output_inside_log)
+    {
+        if (output_log_discarding)
+        {
+            output_statistics.dropped_bytes++;
+            return;
+        }
+
+        if (output_free() == 0)
+            ushell_output_flush();
+
+        if (output_free() == 0)
+        {
+            bool room = false;
+            switch (output_policy)
+            {
+                case OUTPUT_POLICY_BLOCK:
+                    room = output_wait();
+                    break;
+
+                case OUTPUT_POLICY_DROP_OLDEST:
+                    room = output_drop_oldest_log_line();
+                    break;
+
+                case OUTPUT_POLICY_DROP_NEWEST:
+                    break;
+            }
+
+            if (!room)
+            {
+                output_discard_log_line();
+                output_statistics.dropped_bytes++;
+                return;
+            }
+        }
+    }
+    else
+    {
+        // queued log lines may make room for interactive output,
+        // which is only dropped, while the link is stalled
+        if (output_free() == 0)
+            ushell_output_flush();
+        while (output_free() == 0
+            && output_policy != OUTPUT_POLICY_BLOCK
+            && output_drop_oldest_log_line());
+        if (!output_wait())
+        {
+            output_statistics.dropped_bytes++;
+            output_lost++;
+            return;
+        }
+    }
+
+    output_buffer[output_head & OUTPUT_MASK] = c;
+    output_head++;
+
+    if (output_used() > output_statistics.high_water)
+        output_statistics.high_water = output_used();
+}
+
+void ushell_output_char(uint8_t c)
+{
+    #ifdef USHELL_TASKS
+    // other tasks collect their output line by line
+    if (ushell_task_id() != 0)
+    {
+        ushell_tasks_char(c);
+        return;
+    }
+    #endif
+
+    if (current_output_handler != 0)
+    {
+        (*current_output_handler)(c);
+        return;
+    }
+
+    #ifdef USHELL_SCROLLBACK
+    ushell_scrollback_char(c);
+    #endif
+    output_enqueue(c);
+    ushell_output_flush();
+}
+
+void ushell_output_string(char* s)
+{
+    #ifdef USHELL_TASKS
+    if (ushell_task_id() != 0)
+    {
+        while (*s != '\0')
+        {
+            ushell_tasks_char(*(uint8_t*) s++);
+        }
+        return;
+    }
+    #endif
+
+    if (current_output_handler != 0)
+    {
+        while (*s != '\0')
+        {
+            (*current_output_handler)(*(uint8_t*) s++);
+        }
+        return;
+    }
+
+    while (*s != '\0')
+    {
+        #ifdef USHELL_SCROLLBACK
+        ushell_scrollback_char(*(uint8_t*) s);
+        #endif
+        output_enqueue(*(uint8_t*) s++);
+    }
+    ushell_output_flush();
+}
+
+void ushell_output_begin_log()
+{
+    #ifdef USHELL_TASKS
+    if (ushell_task_id() != 0)
+    {
+        ushell_tasks_begin_log();
+        return;
+    }
+    #endif
+
+    output_inside_log = true;
+    output_log_discarding = false;
+    output_log_truncated = false;
+    output_log_start = output_head;
+
+    // log lines must not be interleaved with a transfer
+    if (ushell_receiving())
+    {
+        output_log_discarding = true;
+        output_statistics.dropped_lines++;
+    }
+}
+
+void ushell_output_end_log()
+{
+    #ifdef USHELL_TASKS
+    if (ushell_task_id() != 0)
+    {
+        ushell_tasks_end_log();
+        return;
+    }
+    #endif
+
+    if (!output_inside_log)
+        return;
+    output_inside_log = false;
+
+    if (output_log_discarding)
+    {
+        output_log_discarding = false;
+        if (output_log_truncated && output_log_frame)
+        {
+            // the receiver resynchronizes at the frame delimiter
+            output_log_truncated = false;
+            output_enqueue(0x00);
+            ushell_output_flush();
+        }
+        else if (output_log_truncated)
+        {
+            output_log_truncated = false;
+            ushell_output_string(LINEBREAK);
+
+            // the prompt is not on the new line
+            if (current_keystroke_handler == 0)
+                prompt_redraw_pending = true;
+        }
+        return;
+    }
+
+    if (output_head == output_log_start)
+        return;
+
+    // remember the completed line, so that it can be dropped later on
+    output_forget_transmitted_log_lines();
+    if (output_log_line_count >= USHELL_OUTPUT_MAX_LOG_LINES)
+    {
+        output_log_line_count--;
+        memmove(output_log_lines, &output_log_lines[1], output_log_line_count*sizeof(output_log_line_t));
+    }
+    output_log_lines[output_log_line_count].start = output_log_start;
+    output_log_lines[output_log_line_count].end = output_head;
+    output_log_line_count++;
+
+    ushell_output_flush();
+}
+
+void ushell_output_frame(uint8_t* data, uint16_t length)
+{
+    #ifdef USHELL_TASKS
+    if (ushell_task_id() != 0)
+    {
+        ushell_tasks_frame(data, length);
+        return;
+    }
+    #endif
+
+    ushell_output_begin_log();
+    output_log_frame = true;
+    for (uint16_t i=0; i<length; i++)
+        output_enqueue(data[i]);
+    ushell_output_end_log();
+    output_log_frame = false;
+}
+
+void ushell_output_set_policy(output_policy_t policy)
+{
+    output_policy = policy;
+}
+
+bool ushell_output_pending()
+{
+    return output_head != output_tail;
+}
+
+void ushell_output_pause()
+{
+    output_paused = true;
+}
+
+void ushell_output_resume()
+{
+    output_paused = false;
+}
+
+bool ushell_output_stalled()
+{
+    return output_paused || !terminal_output_ready();
+}
+
+output_statistics_t* ushell_output_statistics()
+{
+    return &output_statistics;
+}
+
+void ushell_output_tick(uint32_t milliseconds)
+{
+    if (ushell_output_pending() && ushell_output_stalled())
+        output_statistics.stalled_ms += milliseconds;
+}
+
+void ushell_attach_output_handler(output_handler_t h)
+{
+    current_output_handler = h;
+}
+
+void ushell_release_output_handler()
+{
+    current_output_handler = 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * Buffered shell output with flow control
+ * ---------------------------------------------
+ *
+ * All shell output is queued in a transmit buffer
+ * and handed to the terminal only while the link accepts data,
+ * i.e. neither paused via XOFF nor blocked by terminal_output_ready().
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_OUTPUT_H
+#define USHELL_OUTPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// size of the transmit buffer in bytes, must be a power of two
+#define USHELL_OUTPUT_BUFFER_SIZE   256
+
+// maximum number of queued log lines, which can be dropped individually
+#define USHELL_OUTPUT_MAX_LOG_LINES 8
+
+// if enabled, XON/XOFF received from the terminal resume/pause the output
+#define USHELL_FLOW_CONTROL_XONXOFF
+
+#define KEY_XON     0x11
+#define KEY_XOFF    0x13
+
+/**
+ * What to do, when a log message does not fit into the transmit buffer
+ *
+ * Interactive output (prompt, echo, application output)
+ * waits for buffer space and is only dropped,
+ * while the link does not accept data (XOFF, terminal_output_ready()),
+ * so that the caller never stalls; the loss is reported in the output,
+ * once the link accepts data again.
+ */
+typedef enum
+{
+    /*
+     * Wait until the terminal accepted enough data,
+     * but drop the line, while the link does not accept data.
+     */
+    OUTPUT_POLICY_BLOCK,
+
+    /*
+     * Discard the oldest queued log lines to make room.
+     */
+    OUTPUT_POLICY_DROP_OLDEST,
+
+    /*
+     * Discard the new log line.
+     */
+    OUTPUT_POLICY_DROP_NEWEST,
+} output_policy_t;
+
+typedef struct
+{
+    // number of bytes and log lines discarded
+    uint32_t dropped_bytes;
+    uint32_t dropped_lines;
+
+    // time spent with output pending, but the link not accepting data
+    uint32_t stalled_ms;
+
+    // maximum number of bytes queued at once
+    uint16_t high_water;
+} output_statistics_t;
+
+/*
+ * Optional output methods, which may be defined in the main code
+ *
+ * terminal_output_ready() shall return false,
+ * while the link can not accept data, e.g. CTS is deasserted.
+ *
+ * terminal_output_buffer() shall transmit up to length bytes
+ * and return the number of bytes actually accepted.
+ */
+extern bool terminal_output_ready();
+extern uint16_t terminal_output_buffer(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Configure how to handle log messages, when the transmit buffer is full
+ */
+void ushell_output_set_policy(output_policy_t);
+
+/**
+ * @brief Hand as much queued output to the terminal, as it accepts
+ *
+ * Must be invoked from the same context as the output functions.
+ */
+void ushell_output_flush();
+
+/**
+ * @brief Whether output is queued, but not yet transmitted
+ */
+bool ushell_output_pending();
+
+/**
+ * @brief Pause or resume the output e.g. upon XOFF/XON
+ */
+void ushell_output_pause();
+void ushell_output_resume();
+
+/**
+ * @brief Whether the link currently does not accept data
+ */
+bool ushell_output_stalled();
+
+/**
+ * @brief Output statistics counters
+ */
+output_statistics_t* ushell_output_statistics();
+
+/**
+ * @brief Mark the beginning and end of a log line
+ *
+ * Output in between is subject to the configured output policy.
+ */
+void ushell_output_begin_log();
+void ushell_output_end_log();
+
+/**
+ * @brief Queue a block of binary data, e.g. a telemetry frame
+ *
+ * The block bypasses any attached output handler and,
+ * like a log line, is subject to the output policy.
+ * A block cut short is terminated with 0x00, the delimiter of COBS frames.
+ */
+void ushell_output_frame(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Account stalled time; invoked by ushell_advance()
+ */
+void ushell_output_tick(uint32_t milliseconds);
+
+#endif // USHELL_OUTPUT_H
@@ -0,0 +1,209 @@
+/**
+ * Output pager
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "pager.h"
+#include "ushell.h"
+
+
+extern output_handler_t current_output_handler;
+extern keystroke_handler_t current_keystroke_handler;
+
+// output held back beyond the first screen
+uint8_t pager_buffer[USHELL_PAGER_BUFFER_SIZE];
+uint16_t pager_length = 0;
+uint16_t pager_position = 0;
+uint32_t pager_discarded = 0;
+
+// lines output to the terminal before holding back
+uint8_t pager_lines = 0;
+
+bool pager_capturing = false;
+
+
+/**
+ * @brief Output handler filling the first screen, then the buffer
+ */
+void pager_capture(uint8_t c)
+{
+    if (pager_length == 0 && pager_lines < USHELL_PAGER_LINES-1)
+    {
+        ushell_release_output_handler();
+        writec(c);
+        ushell_attach_output_handler(&pager_capture);
+        if (c == '\n')
+            pager_lines++;
+        return;
+    }
+
+    if (pager_length < USHELL_PAGER_BUFFER_SIZE)
+        pager_buffer[pager_length++] = c;
+    else
+        pager_discarded++;
+}
+
+/**
+ * @brief Output held back lines
+ */
+void pager_release(uint16_t lines)
+{
+    while (pager_position < pager_length && lines > 0)
+    {
+        uint8_t c = pager_buffer[pager_position++];
+        writec(c);
+        if (c == '\n')
+            lines--;
+    }
+}
+
+/**
+ * @brief Mark the end of the output, if the buffer could not hold all of it
+ */
+void pager_truncated()
+{
+    if (pager_discarded == 0)
+        return;
+
+    // the buffer may end within a line
+    if (pager_buffer[pager_length-1] != '\n')
+        crlf();
+
+    char buffer[11];
+    uint2str(pager_discarded, buffer);
+    write("(output truncated, ");
+    write(buffer);
+    writeln(" bytes discarded)");
+    pager_discarded = 0;
+}
+
+void pager_prompt()
+{
+    write(ANSI_BG_WHITE ANSI_FG_BLACK "--More--" ANSI_RESET);
+}
+
+void pager_keystroke_handler(uint32_t key)
+{
+    uint16_t lines;
+    if (key == KEY_SPACEBAR || key == KEY_PAGEDOWN)
+    {
+        lines = USHELL_PAGER_LINES-1;
+    }
+    else if (key == KEY_ENTER)
+    {
+        lines = 1;
+    }
+    else if (key == 'q' || key == KEY_CTRL_C)
+    {
+        // discard the remaining output
+        pager_position = pager_length;
+        pager_discarded = 0;
+        lines = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    // replace prompt with output
+    write("\r" ANSI_CLEAR_LINE);
+    pager_release(lines);
+    if (pager_position < pager_length)
+    {
+        pager_prompt();
+        return;
+    }
+
+    pager_truncated();
+    ushell_release_keystroke_handler();
+}
+
+void ushell_pager_start()
+{
+    if (pager_capturing || current_output_handler != 0)
+        return;
+
+    pager_length = 0;
+    pager_position = 0;
+    pager_discarded = 0;
+    pager_lines = 0;
+    pager_capturing = true;
+    ushell_attach_output_handler(&pager_capture);
+}
+
+bool ushell_paging()
+{
+    return pager_capturing || current_keystroke_handler == &pager_keystroke_handler;
+}
+
+bool ushell_pager_discarding()
+{
+    return pager_capturing && pager_length >= USHELL_PAGER_BUFFER_SIZE;
+}
+
+bool ushell_pager_pipe(char* line)
+{
+    // find the last unquoted '|', which is not part of "||"
+    char* pipe = 0;
+    char quote = 0;
+    for (char* s=line; *s != '\0'; s++)
+    {
+        if (quote != 0)
+        {
+            if (*s == quote)
+                quote = 0;
+        }
+        else if (*s == '\'' || *s == '"')
+        {
+            quote = *s;
+        }
+        else if (*s == '|')
+        {
+            if (s[1] == '|')
+                s++;
+            else
+                pipe = s;
+        }
+    }
+    if (pipe == 0)
+        return false;
+
+    char* s = pipe + 1;
+    while (*s == ' ')
+        s++;
+    if (strncmp(s, "more", 4) != 0)
+        return false;
+    s += 4;
+    while (*s == ' ')
+        s++;
+    if (*s != '\0')
+        return false;
+
+    *pipe = '\0';
+    return true;
+}
+
+void ushell_pager_finish()
+{
+    if (!pager_capturing)
+        return;
+    pager_capturing = false;
+    ushell_release_output_handler();
+
+    if (pager_length == 0)
+        return;
+
+    // an application remaining running keeps the keyboard
+    if (current_keystroke_handler != 0)
+    {
+        pager_release(USHELL_PAGER_BUFFER_SIZE);
+        pager_truncated();
+        return;
+    }
+
+    pager_prompt();
+    ushell_attach_keystroke_handler(&pager_keystroke_handler);
+}
@@ -0,0 +1,65 @@
+/**
+ * Output pager
+ * ---------------------------------------------
+ *
+ * Holds back the output of a command beyond the first screen
+ * and releases it a screen at a time on demand:
+ *   space, PAGEDOWN: next screen
+ *   enter:           next line
+ *   q, Ctrl-C:       discard the remaining output
+ *
+ * Paging is enabled by appending "| more" to a command line
+ * or by an application invoking ushell_pager_start().
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_PAGER_H
+#define USHELL_PAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of terminal lines per screen
+#define USHELL_PAGER_LINES          24
+
+// number of bytes held back; further output is discarded and the truncation marked
+#define USHELL_PAGER_BUFFER_SIZE    1024
+
+/**
+ * @brief Page all following output of the current command line
+ *
+ * Has no effect, if output is captured, e.g. by ushell_exec() or watch.
+ * Applications remaining running (keystroke handler) can not be paged.
+ */
+void ushell_pager_start();
+
+/**
+ * @brief Whether output is currently being paged
+ */
+bool ushell_paging();
+
+/**
+ * @brief Whether the pager discards output, because its buffer is full
+ *
+ * Applications producing long output may stop early,
+ * since nobody will read it.
+ */
+bool ushell_pager_discarding();
+
+/**
+ * @brief Strip a trailing "| more" from a command line
+ * @return Whether the command line ended with "| more"
+ */
+bool ushell_pager_pipe(char* line);
+
+/**
+ * @brief Stop capturing once the command line was executed;
+ *        invoked by the shell
+ *
+ * If output was held back, the pager prompts the user to release it.
+ */
+void ushell_pager_finish();
+
+#endif // USHELL_PAGER_H
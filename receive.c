@@ -0,0 +1,351 @@
+/**
+ * Binary upload channel
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "receive.h"
+#include "ushell.h"
+#include "syslog.h"
+
+
+// XMODEM control characters
+#define SOH     0x01
+#define EOT     0x04
+#define ACK     0x06
+#define NAK     0x15
+#define CAN     0x18
+
+#define XMODEM_DATA_SIZE    128
+#define XMODEM_PACKET_SIZE  (3 + XMODEM_DATA_SIZE + 2)
+
+extern keystroke_handler_t current_keystroke_handler;
+
+bool receive_active = false;
+receive_mode_t receive_mode;
+receive_sink_t receive_sink;
+uint32_t receive_bytes = 0;
+uint16_t receive_crc;
+
+// Base64 decoder state
+uint8_t base64_block[USHELL_RECEIVE_BLOCK_SIZE];
+uint16_t base64_block_length;
+uint32_t base64_bits;
+uint8_t base64_bit_count;
+
+// XMODEM receiver state
+uint8_t xmodem_packet[XMODEM_PACKET_SIZE];
+uint8_t xmodem_packet_length;
+uint8_t xmodem_expected_block;
+bool xmodem_started;
+uint8_t xmodem_retries;
+uint32_t xmodem_last_activity;
+
+
+/**
+ * @brief Keeps the prompt suspended during the transfer; never invoked
+ */
+void receive_keystroke_handler(uint32_t key)
+{
+}
+
+/**
+ * @brief Leave receive mode and return to the prompt
+ */
+void receive_finish(bool success)
+{
+    receive_active = false;
+
+    if (success)
+        success = (*receive_sink)(0, 0);
+
+    char buffer[11];
+    crlf();
+    if (success)
+        write("Received ")
+    else
+        write("Aborted after ")
+    uint2str(receive_bytes, buffer);
+    write(buffer);
+    write(" bytes, CRC 0x");
+    uint8_t crc[2] = { receive_crc >> 8, receive_crc & 0xFF };
+    hex_encode(crc, 2, buffer);
+    writeln(buffer);
+
+    ushell_release_keystroke_handler();
+}
+
+/**
+ * @brief Deliver decoded data to the sink
+ * @return false, if the sink aborted the transfer
+ */
+bool receive_deliver(uint8_t* data, uint16_t length)
+{
+    receive_bytes += length;
+    receive_crc = crc16(receive_crc, data, length);
+    return (*receive_sink)(data, length);
+}
+
+/**
+ * @brief Value of a Base64 character
+ * @return 0-63, 64 for padding, 0xFF for characters to ignore
+ */
+uint8_t base64_value(uint8_t c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    if (c == '=')
+        return 64;
+    return 0xFF;
+}
+
+/**
+ * @brief Deliver the decoded bytes collected so far
+ */
+bool base64_flush()
+{
+    if (base64_block_length == 0)
+        return true;
+
+    // progress
+    bool accepted = receive_deliver(base64_block, base64_block_length);
+    base64_block_length = 0;
+    char buffer[11];
+    uint2str(receive_bytes, buffer);
+    writec('\r');
+    write(buffer);
+    write(" bytes");
+    return accepted;
+}
+
+void base64_input(uint8_t c)
+{
+    if (c == KEY_CTRL_C)
+    {
+        receive_finish(false);
+        return;
+    }
+
+    // Ctrl-D
+    if (c == EOT)
+    {
+        receive_finish(base64_flush());
+        return;
+    }
+
+    uint8_t v = base64_value(c);
+    if (v == 0xFF)
+        return;
+
+    // padding completes a quantum without adding data
+    if (v == 64)
+    {
+        base64_bit_count = 0;
+        return;
+    }
+
+    base64_bits = (base64_bits << 6) | v;
+    base64_bit_count += 6;
+    if (base64_bit_count < 8)
+        return;
+
+    base64_bit_count -= 8;
+    base64_block[base64_block_length++] = base64_bits >> base64_bit_count;
+
+    if (base64_block_length >= USHELL_RECEIVE_BLOCK_SIZE && !base64_flush())
+        receive_finish(false);
+}
+
+/**
+ * @brief Cancel an XMODEM transfer
+ */
+void xmodem_cancel()
+{
+    writec(CAN);
+    writec(CAN);
+    receive_finish(false);
+}
+
+/**
+ * @brief Validate and acknowledge a complete packet
+ */
+void xmodem_packet_complete()
+{
+    uint8_t block = xmodem_packet[1];
+    uint16_t crc = (xmodem_packet[3+XMODEM_DATA_SIZE] << 8) | xmodem_packet[4+XMODEM_DATA_SIZE];
+
+    if ((uint8_t) (block ^ xmodem_packet[2]) != 0xFF
+     || crc16(0, &xmodem_packet[3], XMODEM_DATA_SIZE) != crc)
+    {
+        writec(NAK);
+        return;
+    }
+
+    if (block == xmodem_expected_block)
+    {
+        xmodem_started = true;
+        if (!receive_deliver(&xmodem_packet[3], XMODEM_DATA_SIZE))
+        {
+            xmodem_cancel();
+            return;
+        }
+        xmodem_expected_block++;
+        writec(ACK);
+    }
+    else if (block == (uint8_t) (xmodem_expected_block-1))
+    {
+        // our acknowledgement got lost, the sender repeats
+        writec(ACK);
+    }
+    else
+    {
+        xmodem_cancel();
+    }
+}
+
+void xmodem_input(uint8_t c)
+{
+    xmodem_last_activity = ushell_uptime_ms();
+
+    if (xmodem_packet_length == 0)
+    {
+        switch (c)
+        {
+            case SOH:
+                xmodem_packet[xmodem_packet_length++] = c;
+                break;
+
+            case EOT:
+                writec(ACK);
+                receive_finish(true);
+                break;
+
+            case CAN:
+                receive_finish(false);
+                break;
+        }
+        return;
+    }
+
+    xmodem_packet[xmodem_packet_length++] = c;
+    if (xmodem_packet_length >= XMODEM_PACKET_SIZE)
+    {
+        xmodem_packet_length = 0;
+        xmodem_packet_complete();
+    }
+}
+
+void ushell_receive_start(receive_mode_t mode, receive_sink_t sink)
+{
+    receive_mode = mode;
+    receive_sink = sink;
+    receive_bytes = 0;
+    receive_crc = 0;
+    receive_active = true;
+
+    base64_block_length = 0;
+    base64_bits = 0;
+    base64_bit_count = 0;
+
+    xmodem_packet_length = 0;
+    xmodem_expected_block = 1;
+    xmodem_started = false;
+    xmodem_retries = 0;
+    xmodem_last_activity = ushell_uptime_ms();
+
+    // suspend the prompt until the transfer ends
+    ushell_attach_keystroke_handler(&receive_keystroke_handler);
+
+    if (mode == RECEIVE_XMODEM)
+    {
+        // request transfer with CRC
+        writec('C');
+    }
+}
+
+void ushell_receive_abort()
+{
+    if (!receive_active)
+        return;
+
+    if (receive_mode == RECEIVE_XMODEM)
+        xmodem_cancel();
+    else
+        receive_finish(false);
+}
+
+bool ushell_receiving()
+{
+    return receive_active;
+}
+
+uint32_t ushell_received_bytes()
+{
+    return receive_bytes;
+}
+
+void ushell_receive_input(uint8_t c)
+{
+    if (receive_mode == RECEIVE_XMODEM)
+        xmodem_input(c);
+    else
+        base64_input(c);
+}
+
+void ushell_receive_poll()
+{
+    if (!receive_active || receive_mode != RECEIVE_XMODEM)
+        return;
+
+    uint32_t idle = ushell_uptime_ms() - xmodem_last_activity;
+
+    // incomplete packet, including the first one
+    if (xmodem_packet_length > 0)
+    {
+        if (idle >= USHELL_XMODEM_BYTE_TIMEOUT_MS)
+        {
+            xmodem_packet_length = 0;
+            xmodem_last_activity = ushell_uptime_ms();
+            writec(NAK);
+        }
+        return;
+    }
+
+    if (!xmodem_started)
+    {
+        if (idle < USHELL_XMODEM_START_INTERVAL_MS)
+            return;
+
+        // sender not ready yet: repeat the request
+        if (++xmodem_retries >= USHELL_XMODEM_START_RETRIES)
+        {
+            xmodem_cancel();
+            return;
+        }
+        xmodem_last_activity = ushell_uptime_ms();
+        writec('C');
+    }
+}
+
+uint32_t ushell_receive_deadline()
+{
+    if (!receive_active || receive_mode != RECEIVE_XMODEM)
+        return USHELL_NO_DEADLINE;
+
+    // the same conditions as in ushell_receive_poll()
+    if (xmodem_packet_length > 0)
+        return xmodem_last_activity + USHELL_XMODEM_BYTE_TIMEOUT_MS;
+    if (!xmodem_started)
+        return xmodem_last_activity + USHELL_XMODEM_START_INTERVAL_MS;
+    return USHELL_NO_DEADLINE;
+}
@@ -0,0 +1,86 @@
+/**
+ * Binary upload channel
+ * ---------------------------------------------
+ *
+ * Lets an application receive binary data via the console,
+ * bypassing echo and line editing.
+ * Decoded data is delivered in blocks to a sink provided by the application.
+ *
+ * Supported framings:
+ *   Base64: Whitespace is ignored, Ctrl-D ends, Ctrl-C aborts the transfer.
+ *           The CRC-16/XMODEM of the decoded data is reported at the end.
+ *   XMODEM-CRC: 128-byte blocks, the last block is padded with 0x1A.
+ *
+ * During a transfer, log messages and telemetry frames are dropped,
+ * scheduled commands and output from other tasks are deferred.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_RECEIVE_H
+#define USHELL_RECEIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of decoded bytes delivered to the sink at once in Base64 mode
+#define USHELL_RECEIVE_BLOCK_SIZE   128
+
+// XMODEM timing
+#define USHELL_XMODEM_START_INTERVAL_MS 3000
+#define USHELL_XMODEM_START_RETRIES     10
+#define USHELL_XMODEM_BYTE_TIMEOUT_MS   1000
+
+typedef enum
+{
+    RECEIVE_BASE64,
+    RECEIVE_XMODEM,
+} receive_mode_t;
+
+/*
+ * Receives decoded data;
+ * length 0 signals the end of a successful transfer.
+ * Return false to abort the transfer.
+ */
+typedef bool (*receive_sink_t)(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Switch the console into receive mode
+ *
+ * May be invoked from within an application.
+ * The shell returns to the prompt, when the transfer ends.
+ */
+void ushell_receive_start(receive_mode_t mode, receive_sink_t sink);
+
+/**
+ * @brief Abort an ongoing transfer
+ */
+void ushell_receive_abort();
+
+/**
+ * @brief Whether a transfer is in progress
+ */
+bool ushell_receiving();
+
+/**
+ * @brief Number of bytes received during the current or previous transfer
+ */
+uint32_t ushell_received_bytes();
+
+/**
+ * @brief Process a received byte; invoked by ushell_input_char()
+ */
+void ushell_receive_input(uint8_t);
+
+/**
+ * @brief Handle timeouts; invoked by ushell_poll()
+ */
+void ushell_receive_poll();
+
+/**
+ * @brief Time of the next timeout or USHELL_NO_DEADLINE
+ */
+uint32_t ushell_receive_deadline();
+
+#endif // USHELL_RECEIVE_H
@@ -0,0 +1,93 @@
+/**
+ * Keystroke session recorder
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "recorder.h"
+#include "ushell.h"
+
+
+ushell_trace_sink_t recorder_sink = 0;
+
+// staged trace data
+uint8_t recorder_buffer[USHELL_RECORDER_BUFFER_SIZE];
+uint8_t recorder_length = 0;
+
+// time of the previous record
+uint32_t recorder_time;
+
+
+/**
+ * @brief Hand all staged data to the sink
+ */
+void recorder_flush()
+{
+    if (recorder_length > 0)
+    {
+        (*recorder_sink)(recorder_buffer, recorder_length);
+        recorder_length = 0;
+    }
+}
+
+/**
+ * @brief Append one byte to the trace
+ */
+void recorder_put(uint8_t b)
+{
+    if (recorder_length >= USHELL_RECORDER_BUFFER_SIZE)
+        recorder_flush();
+    recorder_buffer[recorder_length++] = b;
+}
+
+void ushell_record_start(ushell_trace_sink_t sink)
+{
+    if (recorder_sink != 0)
+        ushell_record_stop();
+
+    recorder_sink = sink;
+    recorder_length = 0;
+    recorder_time = ushell_uptime_ms();
+
+    // header
+    for (uint8_t i=0; i<4; i++)
+        recorder_put(USHELL_TRACE_MAGIC[i]);
+    recorder_put(USHELL_TRACE_VERSION);
+    recorder_put(USHELL_TICK_MS);
+}
+
+void ushell_record_stop()
+{
+    if (recorder_sink == 0)
+        return;
+
+    recorder_flush();
+    recorder_sink = 0;
+}
+
+bool ushell_recording()
+{
+    return recorder_sink != 0;
+}
+
+void ushell_record_input(uint8_t c)
+{
+    if (recorder_sink == 0)
+        return;
+
+    uint32_t now = ushell_uptime_ms();
+    uint32_t delta = now - recorder_time;
+    recorder_time = now;
+
+    // LEB128-encoded time delta
+    while (delta >= 0x80)
+    {
+        recorder_put((delta & 0x7F) | 0x80);
+        delta >>= 7;
+    }
+    recorder_put(delta);
+
+    recorder_put(c);
+}
@@ -0,0 +1,58 @@
+/**
+ * Keystroke session recorder
+ * ---------------------------------------------
+ *
+ * Records every byte passed to ushell_input_char()
+ * together with its time of arrival into a compact binary trace,
+ * which can be replayed on the host using tools/replay.
+ *
+ * Trace format:
+ *   "USHT" [version] [tick in ms]      (header, 6 bytes)
+ *   [delta] [byte]                     (one record per input byte)
+ *
+ * The delta is the number of milliseconds elapsed since the previous record,
+ * encoded as unsigned LEB128 (7 bits per byte, MSB set if more bytes follow).
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_RECORDER_H
+#define USHELL_RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define USHELL_TRACE_MAGIC      "USHT"
+#define USHELL_TRACE_VERSION    1
+
+// number of bytes staged before they are handed to the sink
+#define USHELL_RECORDER_BUFFER_SIZE 32
+
+/*
+ * Sink receiving the recorded trace in chunks,
+ * e.g. writing it to a file or a flash sector
+ */
+typedef void (*ushell_trace_sink_t)(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Begin recording all input into a new trace
+ */
+void ushell_record_start(ushell_trace_sink_t);
+
+/**
+ * @brief Stop recording and hand all staged data to the sink
+ */
+void ushell_record_stop();
+
+/**
+ * @brief Whether a recording is in progress
+ */
+bool ushell_recording();
+
+/**
+ * @brief Append an input byte to the trace; invoked by ushell_input_char()
+ */
+void ushell_record_input(uint8_t);
+
+#endif // USHELL_RECORDER_H
@@ -0,0 +1,351 @@
+/**
+ * Scheduled commands
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "schedule.h"
+#include "ushell.h"
+#include "syslog.h"
+
+
+extern keystroke_handler_t current_keystroke_handler;
+extern bool prompt_redraw_pending;
+extern int ushell_status;
+
+typedef struct
+{
+    // neighbours within the job's list, 0 if none
+    uint8_t next;
+    uint8_t previous;
+
+    // wheel slot or SCHEDULE_DUE
+    uint8_t list;
+
+    // wheel tick, at which the command is due
+    uint32_t expiry;
+
+    // milliseconds between executions, 0 to execute once
+    uint32_t period;
+
+    // the command's substrings, each null-terminated
+    uint8_t argc;
+    char arguments[USHELL_SCHEDULE_ARGUMENTS_SIZE];
+} schedule_job_t;
+
+// list of jobs to execute during the current poll
+#define SCHEDULE_DUE    USHELL_SCHEDULE_WHEEL_SLOTS
+
+// jobs are referred to by their number, i.e. index plus one
+schedule_job_t schedule_jobs[USHELL_SCHEDULE_JOBS];
+#define schedule_job(n)     (&schedule_jobs[(n)-1])
+
+// one bit per job in use
+uint32_t schedule_used = 0;
+
+// first job in each wheel slot and in the due list, 0 if empty
+uint8_t schedule_lists[USHELL_SCHEDULE_WHEEL_SLOTS+1];
+
+// tick, up to which the wheel has advanced, and the uptime it began at
+uint32_t schedule_tick = 0;
+uint32_t schedule_time = 0;
+
+
+/**
+ * @brief Number of ticks covering a duration, rounded up
+ */
+uint32_t schedule_ticks(uint32_t milliseconds)
+{
+    return (milliseconds + USHELL_SCHEDULE_RESOLUTION_MS-1) / USHELL_SCHEDULE_RESOLUTION_MS;
+}
+
+/**
+ * @brief Insert a job at the head of a list
+ */
+void schedule_link(uint8_t n, uint8_t list)
+{
+    schedule_job_t* job = schedule_job(n);
+    job->list = list;
+    job->previous = 0;
+    job->next = schedule_lists[list];
+    if (job->next != 0)
+        schedule_job(job->next)->previous = n;
+    schedule_lists[list] = n;
+}
+
+/**
+ * @brief Remove a job from its list
+ */
+void schedule_unlink(uint8_t n)
+{
+    schedule_job_t* job = schedule_job(n);
+    if (job->previous != 0)
+        schedule_job(job->previous)->next = job->next;
+    else
+        schedule_lists[job->list] = job->next;
+    if (job->next != 0)
+        schedule_job(job->next)->previous = job->previous;
+}
+
+/**
+ * @brief Insert a job into the wheel slot, its expiry hashes to
+ */
+void schedule_insert(uint8_t n)
+{
+    schedule_link(n, schedule_job(n)->expiry & (USHELL_SCHEDULE_WHEEL_SLOTS-1));
+}
+
+/**
+ * @brief Milliseconds until a job is due
+ */
+uint32_t schedule_remaining(schedule_job_t* job)
+{
+    uint32_t due = (job->expiry - schedule_tick) * USHELL_SCHEDULE_RESOLUTION_MS;
+    uint32_t elapsed = ushell_uptime_ms() - schedule_time;
+    return (due > elapsed) ? due - elapsed : 0;
+}
+
+/**
+ * @brief Common implementation of every and after
+ */
+int schedule_command(uint8_t argc, char* argv[], bool periodic)
+{
+    if (argc < 3)
+    {
+        if (periodic)
+            log_error("Usage: every <period> <command> [arguments]");
+        else
+            log_error("Usage: after <delay> <command> [arguments]");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    uint32_t milliseconds;
+    if (!str2duration(argv[1], &milliseconds) || (periodic && milliseconds == 0))
+    {
+        log_error("Invalid duration");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    uint16_t length = 0;
+    for (uint8_t i=2; i<argc; i++)
+        length += strlen(argv[i]) + 1;
+    if (length > USHELL_SCHEDULE_ARGUMENTS_SIZE)
+    {
+        log_error("Command too long");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    // allocate the lowest free job
+    uint32_t unused = ~schedule_used;
+    if (unused == 0 || __builtin_ctz(unused) >= USHELL_SCHEDULE_JOBS)
+    {
+        log_error("Too many scheduled commands");
+        return USHELL_STATUS_FAILURE;
+    }
+    uint8_t n = __builtin_ctz(unused) + 1;
+    schedule_job_t* job = schedule_job(n);
+    schedule_used |= 1UL << (n-1);
+
+    // keep the tokenized command, since the command line is reused
+    uint16_t offset = 0;
+    for (uint8_t i=2; i<argc; i++)
+    {
+        uint8_t l = strlen(argv[i]) + 1;
+        memcpy(&job->arguments[offset], argv[i], l);
+        offset += l;
+    }
+    job->argc = argc - 2;
+    job->period = periodic ? milliseconds : 0;
+
+    // the wheel may lag behind the uptime until the next poll
+    uint32_t ticks = schedule_ticks(ushell_uptime_ms() - schedule_time + milliseconds);
+    if (ticks == 0)
+        ticks = 1;
+    job->expiry = schedule_tick + ticks;
+    schedule_insert(n);
+
+    char buffer[11];
+    uint2str(n, buffer);
+    writec('[');
+    write(buffer);
+    writeln("]");
+    return USHELL_STATUS_SUCCESS;
+}
+
+int ushell_every(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    return schedule_command(argc, argv, true);
+}
+
+int ushell_after(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    return schedule_command(argc, argv, false);
+}
+
+int ushell_jobs(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    char buffer[11];
+    for (uint8_t n=1; n<=USHELL_SCHEDULE_JOBS; n++)
+    {
+        if ((schedule_used & (1UL << (n-1))) == 0)
+            continue;
+        schedule_job_t* job = schedule_job(n);
+
+        writec('[');
+        uint2str(n, buffer);
+        write(buffer);
+        write("] ");
+        if (job->period > 0)
+        {
+            write("every ");
+            uint2str(job->period, buffer);
+            write(buffer);
+            write("ms, next");
+        }
+        else
+        {
+            write("once");
+        }
+        write(" in ");
+        uint2str(schedule_remaining(job), buffer);
+        write(buffer);
+        write("ms:");
+
+        char* p = job->arguments;
+        for (uint8_t i=0; i<job->argc; i++)
+        {
+            writec(' ');
+            write(p);
+            p += strlen(p) + 1;
+        }
+        crlf();
+    }
+    return USHELL_STATUS_SUCCESS;
+}
+
+int ushell_kill(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    uint32_t n;
+    if (argc != 2 || !str2uint(argv[1], &n))
+    {
+        log_error("Usage: kill <job>");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    if (n == 0 || n > USHELL_SCHEDULE_JOBS || (schedule_used & (1UL << (n-1))) == 0)
+    {
+        log_error("No such job");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    schedule_unlink(n);
+    schedule_used &= ~(1UL << (n-1));
+    return USHELL_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Execute a job, which was removed from the wheel
+ */
+void schedule_fire(uint8_t n)
+{
+    schedule_job_t* job = schedule_job(n);
+
+    // rebuild the argument vector, as the command may modify it
+    char arguments[USHELL_SCHEDULE_ARGUMENTS_SIZE];
+    char* argv[MAX_SUBSTRINGS];
+    uint8_t argc = job->argc;
+    memcpy(arguments, job->arguments, USHELL_SCHEDULE_ARGUMENTS_SIZE);
+    char* p = arguments;
+    for (uint8_t i=0; i<argc; i++)
+    {
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    // reschedule before executing, so that the command may kill its own job
+    if (job->period > 0)
+    {
+        // keep the schedule, unless we fell behind by more than one period
+        uint32_t ticks = schedule_ticks(job->period);
+        job->expiry += ticks;
+        if ((int32_t) (job->expiry - schedule_tick) <= 0)
+            job->expiry = schedule_tick + ticks;
+        schedule_insert(n);
+    }
+    else
+    {
+        schedule_used &= ~(1UL << (n-1));
+    }
+
+    // output replaces the line being edited, which is redrawn afterwards
+    keystroke_handler_t handler = current_keystroke_handler;
+    if (handler == 0)
+    {
+        write("\r" ANSI_CLEAR_LINE);
+        prompt_redraw_pending = true;
+    }
+
+    // the status of the user's last command remains available
+    int status = ushell_status;
+    current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
+    ushell_execute(argc, argv);
+    current_keystroke_handler = handler;
+    ushell_status = status;
+}
+
+void ushell_schedule_poll()
+{
+    uint32_t ticks = (ushell_uptime_ms() - schedule_time) / USHELL_SCHEDULE_RESOLUTION_MS;
+    if (ticks == 0)
+        return;
+
+    uint32_t first = schedule_tick + 1;
+    schedule_tick += ticks;
+    schedule_time += ticks * USHELL_SCHEDULE_RESOLUTION_MS;
+
+    // visit the slots of all elapsed ticks, each at most once
+    if (ticks > USHELL_SCHEDULE_WHEEL_SLOTS)
+        ticks = USHELL_SCHEDULE_WHEEL_SLOTS;
+    for (uint32_t i=0; i<ticks; i++)
+    {
+        uint8_t n = schedule_lists[(first + i) & (USHELL_SCHEDULE_WHEEL_SLOTS-1)];
+        while (n != 0)
+        {
+            // jobs due in a later revolution remain in the slot
+            uint8_t next = schedule_job(n)->next;
+            if ((int32_t) (schedule_job(n)->expiry - schedule_tick) <= 0)
+            {
+                schedule_unlink(n);
+                schedule_link(n, SCHEDULE_DUE);
+            }
+            n = next;
+        }
+    }
+
+    // execute separately, since commands may schedule or kill jobs
+    while (schedule_lists[SCHEDULE_DUE] != 0)
+    {
+        uint8_t n = schedule_lists[SCHEDULE_DUE];
+        schedule_unlink(n);
+        schedule_fire(n);
+    }
+}
+
+uint32_t ushell_schedule_deadline()
+{
+    if (schedule_used == 0)
+        return USHELL_NO_DEADLINE;
+
+    uint32_t nearest = 0xFFFFFFFF;
+    for (uint8_t n=1; n<=USHELL_SCHEDULE_JOBS; n++)
+    {
+        if ((schedule_used & (1UL << (n-1))) == 0)
+            continue;
+        uint32_t ticks = schedule_job(n)->expiry - schedule_tick;
+        if (ticks < nearest)
+            nearest = ticks;
+    }
+    return schedule_time + nearest * USHELL_SCHEDULE_RESOLUTION_MS;
+}
@@ -0,0 +1,78 @@
+/**
+ * Scheduled commands
+ * ---------------------------------------------
+ *
+ * Built-in commands "every" and "after" execute a command
+ * periodically or once after a delay, e.g.:
+ *
+ *   every 100ms adc_read 3
+ *   after 5s reset_counters
+ *
+ * Commands are tokenized (and variables substituted) when scheduled,
+ * thus firing costs only dispatching them. Scheduled commands
+ * must not remain running (i.e. attach a keystroke handler).
+ *
+ * Pending commands are kept in a hashed timer wheel:
+ * Each job is linked into the slot its expiry hashes to,
+ * so that scheduling, cancelling and firing take constant time,
+ * independent of the number of jobs.
+ * The wheel advances with the shell's time base (see ushell_tick()).
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_SCHEDULE_H
+#define USHELL_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scratch.h"
+
+// maximum number of scheduled commands (at most 32)
+#define USHELL_SCHEDULE_JOBS            8
+
+// number of slots in the timer wheel (must be a power of two)
+#define USHELL_SCHEDULE_WHEEL_SLOTS     16
+
+// milliseconds per slot, scheduled times are rounded up to this
+#define USHELL_SCHEDULE_RESOLUTION_MS   10
+
+// bytes available for a scheduled command and its arguments
+#define USHELL_SCHEDULE_ARGUMENTS_SIZE  48
+
+/**
+ * @brief Built-in command: every <period> <command> [arguments]
+ */
+int ushell_every(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: after <delay> <command> [arguments]
+ */
+int ushell_after(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: jobs
+ *
+ * Lists the scheduled commands.
+ */
+int ushell_jobs(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: kill <job>
+ *
+ * Cancels a scheduled command.
+ */
+int ushell_kill(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Execute scheduled commands, which are due
+ */
+void ushell_schedule_poll();
+
+/**
+ * @brief Time of the next scheduled command or USHELL_NO_DEADLINE
+ */
+uint32_t ushell_schedule_deadline();
+
+#endif // USHELL_SCHEDULE_H
@@ -0,0 +1,154 @@
+/**
+ * Scratch memory for applications
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "scratch.h"
+#include "ushell.h"
+
+
+uint8_t scratch_arena[USHELL_SCRATCH_SIZE] __attribute__((aligned(sizeof(void*))));
+uint16_t scratch_used = 0;
+
+// highest scratch_used since the beginning of the current invocation
+uint16_t scratch_peak = 0;
+
+// highest scratch_used ever
+uint16_t scratch_high_water = 0;
+
+typedef struct
+{
+    const char* name;
+    uint16_t high_water;
+} scratch_statistics_t;
+
+scratch_statistics_t scratch_statistics[USHELL_SCRATCH_STATISTICS];
+uint8_t scratch_statistics_count = 0;
+
+
+// active invocations, the innermost one last
+ushell_context_t scratch_contexts[USHELL_SCRATCH_DEPTH];
+uint8_t scratch_depth = 0;
+
+
+void* ushell_alloc(ushell_context_t* context, uint16_t size)
+{
+    // allocations of outer invocations would be released with the inner one
+    if (context == 0 || scratch_depth == 0 || context != &scratch_contexts[scratch_depth-1])
+        return 0;
+
+    uint32_t aligned = ((uint32_t) size + sizeof(void*) - 1) & ~(uint32_t) (sizeof(void*) - 1);
+    if (aligned > USHELL_SCRATCH_SIZE - scratch_used)
+        return 0;
+
+    void* p = &scratch_arena[scratch_used];
+    scratch_used += aligned;
+    if (scratch_used > scratch_peak)
+        scratch_peak = scratch_used;
+    if (scratch_used > scratch_high_water)
+        scratch_high_water = scratch_used;
+    return p;
+}
+
+uint16_t ushell_scratch_available()
+{
+    return USHELL_SCRATCH_SIZE - scratch_used;
+}
+
+ushell_context_t* ushell_scratch_begin(const char* name)
+{
+    if (scratch_depth >= USHELL_SCRATCH_DEPTH)
+        return 0;
+
+    ushell_context_t* context = &scratch_contexts[scratch_depth++];
+    context->scratch.used = scratch_used;
+    context->scratch.peak = scratch_peak;
+    context->name = name;
+    context->running = false;
+    scratch_peak = scratch_used;
+    return context;
+}
+
+/**
+ * @brief Account an invocation's usage to the application's high-water mark
+ */
+void scratch_account(const char* name, uint16_t used)
+{
+    if (name == 0 || used == 0)
+        return;
+
+    for (uint8_t i=0; i<scratch_statistics_count; i++)
+    {
+        if (strcmp(scratch_statistics[i].name, name) == 0)
+        {
+            if (used > scratch_statistics[i].high_water)
+                scratch_statistics[i].high_water = used;
+            return;
+        }
+    }
+    if (scratch_statistics_count < USHELL_SCRATCH_STATISTICS)
+    {
+        scratch_statistics[scratch_statistics_count].name = name;
+        scratch_statistics[scratch_statistics_count].high_water = used;
+        scratch_statistics_count++;
+    }
+}
+
+void ushell_scratch_end(ushell_context_t* context)
+{
+    if (context == 0)
+        return;
+
+    // invocations nested in this one end as well
+    while (scratch_depth > 0)
+    {
+        ushell_context_t* c = &scratch_contexts[--scratch_depth];
+        uint16_t used = scratch_peak - c->scratch.used;
+
+        // the caller's peak includes the nested invocation
+        if (c->scratch.peak > scratch_peak)
+            scratch_peak = c->scratch.peak;
+        scratch_used = c->scratch.used;
+        scratch_account(c->name, used);
+
+        if (c == context)
+            break;
+    }
+}
+
+void ushell_scratch_end_running()
+{
+    for (uint8_t i=scratch_depth; i>0; i--)
+    {
+        if (scratch_contexts[i-1].running)
+        {
+            ushell_scratch_end(&scratch_contexts[i-1]);
+            return;
+        }
+    }
+}
+
+int ushell_scratch(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    char buffer[11];
+
+    write("Scratch arena: ");
+    uint2str(scratch_high_water, buffer);
+    write(buffer);
+    write(" of " STR(USHELL_SCRATCH_SIZE) " bytes used at most");
+    crlf();
+
+    for (uint8_t i=0; i<scratch_statistics_count; i++)
+    {
+        uint2str(scratch_statistics[i].high_water, buffer);
+        write("  ");
+        write((char*) scratch_statistics[i].name);
+        write(": ");
+        write(buffer);
+        writeln(" bytes");
+    }
+    return USHELL_STATUS_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/**
+ * Scratch memory for applications
+ * ---------------------------------------------
+ *
+ * All applications share one arena, from which they may allocate
+ * temporary buffers for formatting and parsing.
+ * Allocations are released automatically, when the application returns
+ * or, if it remains running, releases its keystroke handler.
+ * Nested invocations (e.g. via ushell_exec()) allocate above their caller.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_SCRATCH_H
+#define USHELL_SCRATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of bytes in the scratch arena
+#define USHELL_SCRATCH_SIZE         512
+
+// number of applications, whose high-water mark is tracked
+#define USHELL_SCRATCH_STATISTICS   16
+
+// number of invocations, which may be active at once,
+// i.e. nested via ushell_exec(), watch or an application remaining running
+#define USHELL_SCRATCH_DEPTH        4
+
+// state of the arena at the beginning of an invocation
+typedef struct
+{
+    uint16_t used;
+    uint16_t peak;
+} scratch_mark_t;
+
+/*
+ * Context of an application invocation, passed to the application
+ */
+typedef struct ushell_context
+{
+    scratch_mark_t scratch;
+
+    // name of the application, for the statistics
+    const char* name;
+
+    // set, while the application remains running after returning
+    bool running;
+} ushell_context_t;
+
+/**
+ * @brief Allocate memory for the duration of an application invocation
+ *
+ * Allocations are aligned to pointer size.
+ * Only the innermost active invocation may allocate.
+ *
+ * @return Pointer to the memory or 0, if the arena is exhausted
+ */
+void* ushell_alloc(ushell_context_t* context, uint16_t size);
+
+/**
+ * @brief Number of bytes, which can still be allocated
+ */
+uint16_t ushell_scratch_available();
+
+/**
+ * @brief Begin an application invocation; invoked by the shell
+ * @return Context to pass to the application and ushell_scratch_end(),
+ *         0 if invocations are nested too deeply
+ */
+ushell_context_t* ushell_scratch_begin(const char* name);
+
+/**
+ * @brief Release all memory allocated during an invocation (and those nested in it)
+ *        and account it to the application's high-water mark
+ */
+void ushell_scratch_end(ushell_context_t* context);
+
+/**
+ * @brief End the innermost invocation, which remained running;
+ *        invoked, when an application releases its keystroke handler
+ */
+void ushell_scratch_end_running();
+
+/**
+ * @brief Built-in command: scratch
+ *
+ * Lists the scratch memory high-water mark of each application.
+ */
+int ushell_scratch(uint8_t argc, char* argv[], ushell_context_t* context);
+
+#endif // USHELL_SCRATCH_H
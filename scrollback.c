@@ -0,0 +1,350 @@
+/**
+ * Scrollback
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "scrollback.h"
+#include "ushell.h"
+#include "syslog.h"
+
+#ifdef USHELL_SCROLLBACK
+
+#define SCROLLBACK_MASK     (USHELL_SCROLLBACK_SIZE-1)
+
+// most recent terminal output
+uint8_t scrollback_buffer[USHELL_SCROLLBACK_SIZE];
+
+// free-running position of the next byte to record
+uint16_t scrollback_head = 0;
+
+// number of recorded bytes, at most USHELL_SCROLLBACK_SIZE
+uint16_t scrollback_length = 0;
+
+// set, once older output was overwritten, i.e. the first line is incomplete
+bool scrollback_overflow = false;
+
+// set, while the scrollback itself is output
+bool scrollback_paused = false;
+
+// position, at which the command line being executed ends, if set
+uint16_t scrollback_command = 0;
+bool scrollback_command_set = false;
+
+#ifndef USHELL_SCROLLBACK_KEEP_ANSI
+// position, at which the current line begins
+uint16_t scrollback_line_start = 0;
+
+// position of the terminal cursor within the current line
+uint16_t scrollback_cursor = 0;
+
+// 0: regular text, 1: after ESC, 2: inside CSI sequence, 3: charset selection
+uint8_t scrollback_escape_state = 0;
+
+// numeric parameter of the CSI sequence being received
+uint16_t scrollback_escape_parameter = 0;
+#endif
+
+
+/**
+ * @brief Append a byte to the ring, overwriting the oldest one when full
+ */
+void scrollback_record(uint8_t c)
+{
+    scrollback_buffer[scrollback_head & SCROLLBACK_MASK] = c;
+    scrollback_head++;
+    if (scrollback_length < USHELL_SCROLLBACK_SIZE)
+        scrollback_length++;
+    else
+        scrollback_overflow = true;
+}
+
+#ifndef USHELL_SCROLLBACK_KEEP_ANSI
+/**
+ * @brief Keep the current line and the cursor within the recorded bytes
+ */
+void scrollback_clamp()
+{
+    uint16_t oldest = scrollback_head - scrollback_length;
+    if ((uint16_t) (scrollback_head - scrollback_line_start) > scrollback_length)
+        scrollback_line_start = oldest;
+    if ((uint16_t) (scrollback_head - scrollback_cursor) > scrollback_length)
+        scrollback_cursor = oldest;
+}
+
+/**
+ * @brief Apply a control sequence moving the cursor or erasing the line
+ */
+void scrollback_control(uint8_t c, uint16_t parameter)
+{
+    scrollback_clamp();
+    uint16_t left = scrollback_cursor - scrollback_line_start;
+    uint16_t right = scrollback_head - scrollback_cursor;
+    if (parameter == 0 && c != 'K')
+        parameter = 1;
+
+    if (c == 'D')
+    {
+        // cursor left, e.g. when erasing a character or recolouring the command
+        scrollback_cursor -= (parameter < left) ? parameter : left;
+    }
+    else if (c == 'C')
+    {
+        scrollback_cursor += (parameter < right) ? parameter : right;
+    }
+    else if (c == 'K' && parameter == 0)
+    {
+        // clear from the cursor to the end of the line
+        scrollback_head -= right;
+        scrollback_length -= right;
+    }
+}
+#endif
+
+void ushell_scrollback_char(uint8_t c)
+{
+    if (scrollback_paused)
+        return;
+
+    #ifdef USHELL_SCROLLBACK_KEEP_ANSI
+    scrollback_record(c);
+    #else
+    switch (scrollback_escape_state)
+    {
+        case 1:
+            scrollback_escape_parameter = 0;
+            if (c == '[')
+                scrollback_escape_state = 2;
+            else if (c == '(' || c == ')')
+                scrollback_escape_state = 3;
+            else
+                scrollback_escape_state = 0;
+            return;
+
+        case 2:
+            if (c >= '0' && c <= '9' && scrollback_escape_parameter < 1000)
+            {
+                scrollback_escape_parameter = 10*scrollback_escape_parameter + (c - '0');
+            }
+            else if (c >= 0x40 && c <= 0x7E)
+            {
+                // final byte of a control sequence
+                scrollback_escape_state = 0;
+                scrollback_control(c, scrollback_escape_parameter);
+            }
+            return;
+
+        case 3:
+            scrollback_escape_state = 0;
+            return;
+    }
+
+    if (c == KEY_ESC)
+    {
+        scrollback_escape_state = 1;
+    }
+    else if (c == '\r')
+    {
+        // following output overwrites the line
+        scrollback_clamp();
+        scrollback_cursor = scrollback_line_start;
+    }
+    else if (c == '\n')
+    {
+        scrollback_record(c);
+        scrollback_line_start = scrollback_head;
+        scrollback_cursor = scrollback_head;
+    }
+    else if (c == '\t' || is_printable(c))
+    {
+        scrollback_clamp();
+        if (scrollback_cursor == scrollback_head)
+        {
+            scrollback_record(c);
+            scrollback_cursor = scrollback_head;
+        }
+        else
+        {
+            scrollback_buffer[scrollback_cursor++ & SCROLLBACK_MASK] = c;
+        }
+    }
+    #endif
+}
+
+void ushell_scrollback_command(bool executing)
+{
+    scrollback_command = scrollback_head;
+    scrollback_command_set = executing;
+}
+
+/**
+ * @brief Reverse a range of the ring buffer in-place
+ */
+void scrollback_reverse(uint16_t from, uint16_t to)
+{
+    while (from + 1 < to)
+    {
+        uint8_t c = scrollback_buffer[from];
+        scrollback_buffer[from++] = scrollback_buffer[--to];
+        scrollback_buffer[to] = c;
+    }
+}
+
+/**
+ * @brief Recorded output, beginning with the first complete line
+ *
+ * The ring is rotated, if necessary, so that its content is contiguous.
+ *
+ * @param length: Receives the number of bytes
+ */
+uint8_t* scrollback_contents(uint16_t* length)
+{
+    uint16_t start = (scrollback_head - scrollback_length) & SCROLLBACK_MASK;
+    if (start + scrollback_length > USHELL_SCROLLBACK_SIZE)
+    {
+        // rotate left by start
+        scrollback_reverse(0, start);
+        scrollback_reverse(start, USHELL_SCROLLBACK_SIZE);
+        scrollback_reverse(0, USHELL_SCROLLBACK_SIZE);
+        uint16_t offset = scrollback_length - scrollback_head;
+        #ifndef USHELL_SCROLLBACK_KEEP_ANSI
+        scrollback_line_start += offset;
+        scrollback_cursor += offset;
+        #endif
+        scrollback_command += offset;
+        scrollback_head = scrollback_length;
+        start = 0;
+    }
+
+    uint8_t* p = &scrollback_buffer[start];
+    uint16_t n = scrollback_length;
+    if (scrollback_overflow)
+    {
+        uint8_t* q = memchr(p, '\n', n);
+        n = (q == 0) ? 0 : n - (q+1 - p);
+        p = (q == 0) ? p : q+1;
+    }
+    *length = n;
+    return p;
+}
+
+/**
+ * @brief Output recorded lines, terminating the last one if necessary
+ */
+void scrollback_write(uint8_t* p, uint16_t length)
+{
+    for (uint16_t i=0; i<length; i++)
+    {
+        #ifndef USHELL_SCROLLBACK_KEEP_ANSI
+        // carriage returns were not recorded
+        if (p[i] == '\n')
+        {
+            crlf();
+            continue;
+        }
+        #endif
+        writec(p[i]);
+    }
+    if (length > 0 && p[length-1] != '\n')
+    {
+        crlf();
+    }
+}
+
+int ushell_scrollback(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    uint32_t lines = 0xFFFFFFFF;
+    if (argc > 2 || (argc == 2 && !str2uint(argv[1], &lines)))
+    {
+        log_error("Usage: scrollback [lines]");
+        return USHELL_STATUS_FAILURE;
+    }
+    if (lines == 0)
+        return USHELL_STATUS_SUCCESS;
+
+    uint16_t n;
+    uint8_t* p = scrollback_contents(&n);
+
+    // find the beginning of the last lines
+    uint16_t i = n;
+    if (i > 0 && p[i-1] == '\n')
+        i--;
+    while (i > 0)
+    {
+        if (p[i-1] == '\n' && --lines == 0)
+            break;
+        i--;
+    }
+
+    scrollback_paused = true;
+    scrollback_write(&p[i], n-i);
+    scrollback_paused = false;
+    return USHELL_STATUS_SUCCESS;
+}
+
+int ushell_grep(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    if (argc != 3 || strcmp(argv[2], "scrollback") != 0)
+    {
+        log_error("Usage: grep <pattern> scrollback");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    // too large for the stack of small targets
+    static search_pattern_t pattern;
+    if (!search_pattern(&pattern, argv[1]))
+    {
+        log_error("Pattern too long");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    uint16_t n;
+    uint8_t* p = scrollback_contents(&n);
+    uint8_t* end = p + n;
+    bool found = false;
+
+    // the command line invoking grep is not searched
+    uint8_t* command_begin = end;
+    uint8_t* command_end = end;
+    uint16_t age = scrollback_head - scrollback_command;
+    if (scrollback_command_set && age <= n)
+    {
+        command_end = end - age;
+        command_begin = command_end;
+        while (command_begin > p && command_begin[-1] != '\n')
+            command_begin--;
+        if (command_end < end && *command_end == '\n')
+            command_end++;
+    }
+
+    // continue searching after each matching line
+    scrollback_paused = true;
+    const uint8_t* match;
+    while ((match = search(&pattern, p, end - p)) != 0)
+    {
+        if (match >= command_begin && match < command_end)
+        {
+            p = command_end;
+            continue;
+        }
+
+        uint8_t* begin = (uint8_t*) match;
+        while (begin > p && begin[-1] != '\n')
+            begin--;
+        uint8_t* line_end = memchr(match, '\n', end - match);
+        line_end = (line_end == 0) ? end : line_end+1;
+
+        scrollback_write(begin, line_end - begin);
+        found = true;
+        p = line_end;
+        if (p >= end)
+            break;
+    }
+    scrollback_paused = false;
+
+    return found ? USHELL_STATUS_SUCCESS : USHELL_STATUS_FAILURE;
+}
+
+#endif // USHELL_SCROLLBACK
@@ -0,0 +1,61 @@
+/**
+ * Scrollback
+ * ---------------------------------------------
+ *
+ * Keeps the most recent terminal output in a ring buffer,
+ * so that log lines and command output missed by the user
+ * can be recovered using the built-in commands:
+ *
+ *   scrollback [lines]            output the last lines (all by default)
+ *   grep <pattern> scrollback     output only the lines containing the pattern
+ *
+ * Output captured by an output handler (e.g. ushell_exec())
+ * and telemetry frames are not recorded.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_SCROLLBACK_H
+#define USHELL_SCROLLBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scratch.h"
+
+// if enabled, terminal output is recorded in the scrollback
+#define USHELL_SCROLLBACK
+
+// size of the scrollback in bytes, must be a power of two (at most 32768)
+#define USHELL_SCROLLBACK_SIZE      1024
+
+// if enabled, ANSI escape sequences are recorded as well,
+// otherwise they are stripped, while carriage returns, cursor movements
+// within the line and clearing the line are applied,
+// e.g. a redrawn prompt replaces the previous one
+//#define USHELL_SCROLLBACK_KEEP_ANSI
+
+/**
+ * @brief Record a character output to the terminal; invoked by the output functions
+ */
+void ushell_scrollback_char(uint8_t c);
+
+/**
+ * @brief Mark the end of the command line entered, before it is executed,
+ *        or clear the mark afterwards; invoked by the shell
+ *
+ * grep does not find the command line invoking it.
+ */
+void ushell_scrollback_command(bool executing);
+
+/**
+ * @brief Built-in command: scrollback [lines]
+ */
+int ushell_scrollback(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: grep <pattern> scrollback
+ */
+int ushell_grep(uint8_t argc, char* argv[], ushell_context_t* context);
+
+#endif // USHELL_SCROLLBACK_H
@@ -0,0 +1,275 @@
+/**
+ * Session snapshot
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "snapshot.h"
+#include "ushell.h"
+#include "alias.h"
+#include "variable.h"
+
+
+// ushell.c
+extern char history_arena[];
+extern uint16_t history_arena_used;
+extern uint8_t history_position;
+
+// alias.c
+extern uint8_t alias_arena[];
+extern uint16_t alias_arena_used;
+extern uint8_t alias_generation;
+
+// variable.c
+extern uint8_t variable_arena[];
+extern uint16_t variable_arena_used;
+extern uint16_t variable_slot[];
+extern uint32_t variable_hash(char* name, uint8_t length);
+
+// snapshot being saved
+ushell_snapshot_sink_t snapshot_sink;
+uint16_t snapshot_crc;
+uint16_t snapshot_length;
+
+
+/**
+ * @brief Hand data to the sink, updating length and CRC
+ */
+void snapshot_emit(void* data, uint16_t length)
+{
+    snapshot_crc = crc16(snapshot_crc, data, length);
+    snapshot_length += length;
+    (*snapshot_sink)(data, length);
+}
+
+/**
+ * @brief Emit the header of a section
+ */
+void snapshot_section(uint8_t section, uint16_t length)
+{
+    uint8_t header[3] = { section, length & 0xFF, length >> 8 };
+    snapshot_emit(header, sizeof(header));
+}
+
+uint16_t ushell_snapshot_save(ushell_snapshot_sink_t sink)
+{
+    snapshot_sink = sink;
+    snapshot_crc = 0;
+    snapshot_length = 0;
+
+    uint8_t header[USHELL_SNAPSHOT_HEADER_SIZE] = USHELL_SNAPSHOT_MAGIC;
+    header[4] = USHELL_SNAPSHOT_VERSION;
+    header[5] = MAX_LENGTH;
+    header[6] = MAX_SUBSTRINGS;
+    snapshot_emit(header, sizeof(header));
+
+    snapshot_section(USHELL_SNAPSHOT_HISTORY, history_arena_used);
+    snapshot_emit(history_arena, history_arena_used);
+
+    snapshot_section(USHELL_SNAPSHOT_ALIASES, alias_arena_used);
+    snapshot_emit(alias_arena, alias_arena_used);
+
+    snapshot_section(USHELL_SNAPSHOT_VARIABLES, 1 + 2*USHELL_VARIABLE_SLOTS + variable_arena_used);
+    uint8_t slots[1 + 2*USHELL_VARIABLE_SLOTS];
+    slots[0] = USHELL_VARIABLE_SLOTS;
+    for (uint8_t i=0; i<USHELL_VARIABLE_SLOTS; i++)
+    {
+        slots[1+2*i] = variable_slot[i] & 0xFF;
+        slots[2+2*i] = variable_slot[i] >> 8;
+    }
+    snapshot_emit(slots, sizeof(slots));
+    snapshot_emit(variable_arena, variable_arena_used);
+
+    uint8_t crc[2] = { snapshot_crc >> 8, snapshot_crc & 0xFF };
+    (*sink)(crc, sizeof(crc));
+    return snapshot_length + sizeof(crc);
+}
+
+/**
+ * @brief Whether the number of '\0'-terminated strings in a range is at least n
+ */
+bool snapshot_strings(const uint8_t* p, const uint8_t* end, uint8_t n)
+{
+    if (p < end && end[-1] != '\0')
+        return false;
+    while (n > 0 && p < end)
+        if (*p++ == '\0')
+            n--;
+    return n == 0;
+}
+
+/**
+ * @brief Validate the entries of an alias arena, see alias.c for their layout
+ */
+bool snapshot_aliases(const uint8_t* data, uint16_t length)
+{
+    uint16_t offset = 0;
+    while (offset < length)
+    {
+        const uint8_t* entry = &data[offset];
+        const uint8_t* end = entry + entry[0];
+
+        // a zero length would never advance
+        if (entry[0] < 3 || entry[0] > length - offset)
+            return false;
+
+        const uint8_t* p = memchr(&entry[1], '\0', entry[0] - 1);
+        if (p == 0)
+            return false;
+
+        // commands must fill the entry exactly
+        for (p++; p < end; p += 3 + p[2])
+        {
+            if (end - p < 3
+             || p[0] > USHELL_SEQUENCE_OR
+             || p[1] > MAX_SUBSTRINGS
+             || p[2] > MAX_LENGTH
+             || end - p - 3 < p[2]
+             || !snapshot_strings(&p[3], &p[3] + p[2], p[1]))
+                return false;
+        }
+        if (p != end)
+            return false;
+        offset += entry[0];
+    }
+    return true;
+}
+
+/**
+ * @brief Validate a variable arena and the slots referring to it, see variable.c for their layout
+ */
+bool snapshot_variables(const uint8_t* slots, const uint8_t* arena, uint16_t length)
+{
+    uint8_t referenced = 0;
+    for (uint8_t i=0; i<USHELL_VARIABLE_SLOTS; i++)
+    {
+        uint16_t s = slots[2*i] | (slots[2*i+1] << 8);
+        if (s != 0 && s != 0xFFFF && s > length)
+            return false;
+    }
+
+    uint16_t offset = 0;
+    while (offset < length)
+    {
+        const uint8_t* entry = &arena[offset];
+        if (entry[0] < 4
+         || entry[0] > length - offset
+         || !snapshot_strings(&entry[2], entry + entry[0], 2))
+            return false;
+
+        if (entry[1])
+        {
+            // a live entry is found through exactly one slot,
+            // which is reached by probing from the name's hash
+            char* name = (char*) &entry[2];
+            uint8_t i = variable_hash(name, strlen(name)) & (USHELL_VARIABLE_SLOTS-1);
+            uint8_t probe = 0;
+            for (; probe<USHELL_VARIABLE_SLOTS; probe++)
+            {
+                uint16_t s = slots[2*i] | (slots[2*i+1] << 8);
+                if (s == 0)
+                    return false;
+                if (s == offset+1)
+                    break;
+                i = (i+1) & (USHELL_VARIABLE_SLOTS-1);
+            }
+            if (probe == USHELL_VARIABLE_SLOTS)
+                return false;
+            referenced++;
+        }
+        offset += entry[0];
+    }
+
+    // no slot may refer to anything else
+    for (uint8_t i=0; i<USHELL_VARIABLE_SLOTS; i++)
+    {
+        uint16_t s = slots[2*i] | (slots[2*i+1] << 8);
+        if (s != 0 && s != 0xFFFF)
+            referenced--;
+    }
+    return referenced == 0;
+}
+
+/**
+ * @brief Walk through all sections, validating or restoring them
+ * @return false, if a section is malformed or does not fit
+ */
+bool snapshot_sections(const uint8_t* p, const uint8_t* end, bool restore)
+{
+    while (p < end)
+    {
+        if (end - p < 3)
+            return false;
+        uint8_t section = p[0];
+        uint16_t length = p[1] | (p[2] << 8);
+        const uint8_t* data = p + 3;
+        if (end - data < length)
+            return false;
+        p = data + length;
+
+        if (section == USHELL_SNAPSHOT_HISTORY)
+        {
+            // entries must be terminated
+            if (length > USHELL_HISTORY_SIZE || (length > 0 && data[length-1] != '\0'))
+                return false;
+            if (restore)
+            {
+                memcpy(history_arena, data, length);
+                history_arena_used = length;
+                history_position = 0;
+            }
+        }
+        else if (section == USHELL_SNAPSHOT_ALIASES)
+        {
+            if (length > USHELL_ALIAS_ARENA_SIZE
+             || !snapshot_aliases(data, length))
+                return false;
+            if (restore)
+            {
+                memcpy(alias_arena, data, length);
+                alias_arena_used = length;
+                alias_generation++;
+            }
+        }
+        else if (section == USHELL_SNAPSHOT_VARIABLES)
+        {
+            // slots depend on the hash table's size
+            uint16_t l = 1 + 2*USHELL_VARIABLE_SLOTS;
+            if (length < l
+             || data[0] != USHELL_VARIABLE_SLOTS
+             || length - l > USHELL_VARIABLE_ARENA_SIZE
+             || !snapshot_variables(&data[1], &data[l], length - l))
+                return false;
+            if (restore)
+            {
+                for (uint8_t i=0; i<USHELL_VARIABLE_SLOTS; i++)
+                    variable_slot[i] = data[1+2*i] | (data[2+2*i] << 8);
+                memcpy(variable_arena, &data[l], length - l);
+                variable_arena_used = length - l;
+            }
+        }
+    }
+    return true;
+}
+
+bool ushell_snapshot_restore(const uint8_t* data, uint16_t length)
+{
+    // aliases are stored tokenized, hence the limits must match
+    if (length < USHELL_SNAPSHOT_HEADER_SIZE + 2
+     || memcmp(data, USHELL_SNAPSHOT_MAGIC, 4) != 0
+     || data[4] != USHELL_SNAPSHOT_VERSION
+     || data[5] != MAX_LENGTH
+     || data[6] != MAX_SUBSTRINGS)
+        return false;
+
+    uint16_t crc = (data[length-2] << 8) | data[length-1];
+    if (crc16(0, data, length-2) != crc)
+        return false;
+
+    const uint8_t* end = data + length - 2;
+    if (!snapshot_sections(data + USHELL_SNAPSHOT_HEADER_SIZE, end, false))
+        return false;
+    return snapshot_sections(data + USHELL_SNAPSHOT_HEADER_SIZE, end, true);
+}
@@ -0,0 +1,63 @@
+/**
+ * Session snapshot
+ * ---------------------------------------------
+ *
+ * Packs the command history, aliases and variables into a binary blob,
+ * which the integrator may persist e.g. in a flash sector, an EEPROM
+ * or a file, and restore at boot.
+ *
+ * Snapshot format:
+ *   "USHS" [version] [MAX_LENGTH] [MAX_SUBSTRINGS]     (header, 7 bytes)
+ *   [section] [length, 2 bytes little endian] [data]   (one per section)
+ *   [CRC-16/XMODEM of all preceding bytes, 2 bytes big endian]
+ *
+ * Sections hold the shell's arenas as they are in memory:
+ *   1: history     [history arena]
+ *   2: aliases     [alias arena]
+ *   3: variables   [slot count] [slots, 2 bytes little endian each] [variable arena]
+ *
+ * Unknown sections are skipped upon restore.
+ * Snapshots from builds with other command line limits are rejected,
+ * since aliases are stored tokenized.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_SNAPSHOT_H
+#define USHELL_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define USHELL_SNAPSHOT_MAGIC       "USHS"
+#define USHELL_SNAPSHOT_VERSION     2
+#define USHELL_SNAPSHOT_HEADER_SIZE 7
+
+#define USHELL_SNAPSHOT_HISTORY     1
+#define USHELL_SNAPSHOT_ALIASES     2
+#define USHELL_SNAPSHOT_VARIABLES   3
+
+/*
+ * Sink receiving the snapshot in chunks,
+ * e.g. writing it to a file or a flash sector
+ */
+typedef void (*ushell_snapshot_sink_t)(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Serialize the session state
+ * @return Total length of the snapshot in bytes
+ */
+uint16_t ushell_snapshot_save(ushell_snapshot_sink_t sink);
+
+/**
+ * @brief Restore the session state from a snapshot
+ *
+ * The snapshot is validated completely (magic, version, limits, CRC, sections),
+ * before any state is modified.
+ *
+ * @return false, if the snapshot is invalid or does not fit this configuration
+ */
+bool ushell_snapshot_restore(const uint8_t* data, uint16_t length);
+
+#endif // USHELL_SNAPSHOT_H
@@ -7,20 +7,34 @@
 #include <ansi.h>
 #include <ushell.h>
 #include <helper.h>
+#include <tasks.h>
 
 
 extern keystroke_handler_t current_keystroke_handler;
-extern char command_line[];
+extern bool prompt_redraw_pending;
 
 void syslog(loglevel_t loglevel, char* filename, uint32_t line, char* message)
 {
     // ushell application running?
+    // (lines from other tasks are placed by ushell_tasks_poll())
+    #ifdef USHELL_TASKS
+    if (current_keystroke_handler == 0 && ushell_task_id() == 0)
+    #else
     if (current_keystroke_handler == 0)
+    #endif
     {
-        // goto beginning of line, clear line
-        write(ANSI_CURSOR_LEFT(80) ANSI_CLEAR_LINE);
+        // goto beginning of line, clear line;
+        // done for every line and not subject to the output policy,
+        // since the log line may be dropped
+        write("\r" ANSI_CLEAR_LINE);
+
+        // the prompt is redrawn once after a burst of log messages
+        prompt_redraw_pending = true;
     }
 
+    // the log line is subject to the output policy
+    ushell_output_begin_log();
+
     // only print filename, if provided
     if (filename != 0)
     {
@@ -64,11 +78,5 @@ void syslog(loglevel_t loglevel, char* filename, uint32_t line, char* message)
     // print message
     writeln(message);
 
-    // reprint shell
-    if (current_keystroke_handler == 0)
-    {
-        // reprint shell
-        ushell_prompt();
-        write(command_line);
-    }
+    ushell_output_end_log();
 }
@@ -0,0 +1,270 @@
+/**
+ * Output from other tasks
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "tasks.h"
+#include "ushell.h"
+
+
+// fallback routines, if no other methods are implemented
+__attribute__((weak)) uint8_t ushell_task_id()
+{
+    return 0;
+}
+
+__attribute__((weak)) void ushell_tasks_notify()
+{
+}
+
+#ifdef USHELL_TASKS
+
+#define TASKS_MASK          (USHELL_TASKS_RING_SIZE-1)
+
+// each line in the ring is preceded by its state and length
+#define TASKS_HEADER_SIZE   2
+
+// a state of 0 marks a line as reserved, but not yet published;
+// the upper bits hold the number of the publishing task
+#define TASKS_READY         0x01
+#define TASKS_LOG           0x02
+#define TASKS_FRAME         0x04
+#define TASKS_ID_SHIFT      3
+
+// replaces the end of a truncated log line
+#define TASKS_TRUNCATED     "...\r\n"
+
+extern keystroke_handler_t current_keystroke_handler;
+extern bool prompt_redraw_pending;
+extern output_statistics_t output_statistics;
+
+typedef struct
+{
+    // number of bytes collected
+    uint8_t length;
+
+    // set between ushell_tasks_begin_log() and ushell_tasks_end_log()
+    bool log;
+
+    // set, once a log line exceeded the buffer
+    bool truncated;
+
+    uint8_t line[USHELL_TASKS_LINE_LENGTH];
+} tasks_line_t;
+
+// only accessed by the respective task, hence not locked
+tasks_line_t tasks_lines[USHELL_TASKS_COUNT];
+
+// published lines
+uint8_t tasks_ring[USHELL_TASKS_RING_SIZE];
+
+// free-running positions of the next byte to reserve (by any task) and to output (by the shell)
+uint16_t tasks_head = 0;
+uint16_t tasks_tail = 0;
+
+// set, while the last line output from the ring is not terminated
+bool tasks_line_open = false;
+
+// task, which output that line
+uint8_t tasks_line_task = 0;
+
+
+/**
+ * @brief Line buffer of the calling task, 0 if its number is out of range
+ */
+tasks_line_t* tasks_line()
+{
+    uint8_t id = ushell_task_id();
+    return (id > 0 && id <= USHELL_TASKS_COUNT) ? &tasks_lines[id-1] : 0;
+}
+
+/**
+ * @brief Publish a record to the ring
+ * @return false, if the ring is full
+ */
+bool tasks_publish(uint8_t state, const uint8_t* data, uint8_t length)
+{
+    uint16_t size = TASKS_HEADER_SIZE + length;
+
+    // reserve space, the only read-modify-write operation per line
+    uint16_t head = __atomic_load_n(&tasks_head, __ATOMIC_RELAXED);
+    do
+    {
+        uint16_t tail = __atomic_load_n(&tasks_tail, __ATOMIC_ACQUIRE);
+        if ((uint16_t) (head + size - tail) > USHELL_TASKS_RING_SIZE)
+        {
+            __atomic_fetch_add(&output_statistics.dropped_bytes, length, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&output_statistics.dropped_lines, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    }
+    while (!__atomic_compare_exchange_n(&tasks_head, &head, head + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    tasks_ring[(uint16_t) (head + 1) & TASKS_MASK] = length;
+    for (uint8_t i=0; i<length; i++)
+        tasks_ring[(uint16_t) (head + TASKS_HEADER_SIZE + i) & TASKS_MASK] = data[i];
+
+    // the shell does not read past an unpublished line
+    state |= TASKS_READY | (ushell_task_id() << TASKS_ID_SHIFT);
+    __atomic_store_n(&tasks_ring[head & TASKS_MASK], state, __ATOMIC_RELEASE);
+
+    ushell_tasks_notify();
+    return true;
+}
+
+/**
+ * @brief Publish the bytes collected in a line buffer
+ */
+void tasks_commit(tasks_line_t* t)
+{
+    if (t->length == 0)
+        return;
+
+    if (t->truncated)
+    {
+        memcpy(&t->line[USHELL_TASKS_LINE_LENGTH - strlen(TASKS_TRUNCATED)], TASKS_TRUNCATED, strlen(TASKS_TRUNCATED));
+        t->truncated = false;
+    }
+    tasks_publish(t->log ? TASKS_LOG : 0, t->line, t->length);
+    t->length = 0;
+}
+
+/**
+ * @brief Release the space of an output record to the tasks
+ */
+void tasks_release(uint16_t tail, uint16_t size)
+{
+    // cleared, so that no stale byte is taken for a state
+    for (uint16_t i=0; i<size; i++)
+        tasks_ring[(uint16_t) (tail + i) & TASKS_MASK] = 0;
+    __atomic_store_n(&tasks_tail, tail + size, __ATOMIC_RELEASE);
+}
+
+void ushell_tasks_char(uint8_t c)
+{
+    tasks_line_t* t = tasks_line();
+    if (t == 0)
+        return;
+
+    if (t->length >= USHELL_TASKS_LINE_LENGTH)
+    {
+        // a log line is published as a whole, lest other lines interleave
+        if (t->log)
+        {
+            t->truncated = true;
+            return;
+        }
+        tasks_commit(t);
+    }
+    t->line[t->length++] = c;
+
+    if (c == '\n' && !t->log)
+        tasks_commit(t);
+}
+
+void ushell_tasks_begin_log()
+{
+    tasks_line_t* t = tasks_line();
+    if (t == 0)
+        return;
+
+    // preceding output is not part of the log line
+    tasks_commit(t);
+    t->log = true;
+}
+
+void ushell_tasks_end_log()
+{
+    tasks_line_t* t = tasks_line();
+    if (t == 0 || !t->log)
+        return;
+
+    tasks_commit(t);
+    t->log = false;
+}
+
+void ushell_tasks_frame(uint8_t* data, uint16_t length)
+{
+    tasks_line_t* t = tasks_line();
+    if (t == 0)
+        return;
+
+    // frames are published as a whole, like log lines
+    if (length > 255)
+    {
+        __atomic_fetch_add(&output_statistics.dropped_bytes, length, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&output_statistics.dropped_lines, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    tasks_publish(TASKS_FRAME, data, length);
+}
+
+/**
+ * @brief Output a frame published by another task
+ */
+void tasks_output_frame(uint16_t tail, uint8_t length)
+{
+    uint8_t frame[255];
+    for (uint8_t i=0; i<length; i++)
+        frame[i] = tasks_ring[(uint16_t) (tail + TASKS_HEADER_SIZE + i) & TASKS_MASK];
+    ushell_output_frame(frame, length);
+}
+
+void ushell_tasks_poll()
+{
+    uint8_t state;
+    while ((state = __atomic_load_n(&tasks_ring[tasks_tail & TASKS_MASK], __ATOMIC_ACQUIRE)) != 0)
+    {
+        uint16_t tail = tasks_tail;
+        uint16_t size = TASKS_HEADER_SIZE + tasks_ring[(uint16_t) (tail + 1) & TASKS_MASK];
+        uint8_t task = state >> TASKS_ID_SHIFT;
+
+        // a line split by another task is not continued
+        if (tasks_line_open && task != tasks_line_task)
+        {
+            crlf();
+            tasks_line_open = false;
+        }
+
+        if (state & TASKS_FRAME)
+        {
+            tasks_output_frame(tail, size - TASKS_HEADER_SIZE);
+            tasks_release(tail, size);
+            continue;
+        }
+
+        // output replaces the line being edited, which is redrawn afterwards
+        if (!tasks_line_open && current_keystroke_handler == 0)
+        {
+            write("\r" ANSI_CLEAR_LINE);
+            prompt_redraw_pending = true;
+        }
+
+        if (state & TASKS_LOG)
+            ushell_output_begin_log();
+
+        uint8_t c = '\n';
+        for (uint16_t i=TASKS_HEADER_SIZE; i<size; i++)
+        {
+            c = tasks_ring[(uint16_t) (tail + i) & TASKS_MASK];
+            writec(c);
+        }
+        tasks_line_open = (c != '\n');
+        tasks_line_task = task;
+
+        if (state & TASKS_LOG)
+            ushell_output_end_log();
+
+        tasks_release(tail, size);
+    }
+}
+
+bool ushell_tasks_pending()
+{
+    return __atomic_load_n(&tasks_ring[tasks_tail & TASKS_MASK], __ATOMIC_ACQUIRE) != 0;
+}
+
+#endif // USHELL_TASKS
@@ -0,0 +1,86 @@
+/**
+ * Output from other tasks
+ * ---------------------------------------------
+ *
+ * On an RTOS, tasks other than the shell's may write and log concurrently.
+ * Instead of locking the transmit buffer for every byte,
+ * each task collects its output in a line buffer of its own
+ * and publishes complete lines to a shared ring
+ * with a single atomic reservation.
+ * ushell_poll() moves published lines to the transmit buffer in order,
+ * placing them above the command line being edited, like log messages.
+ *
+ * Lines, which do not fit into the ring, are dropped
+ * and accounted in the output statistics, since tasks can not wait for the shell.
+ * The GCC __atomic builtins are used; on cores without atomic
+ * compare-and-swap (e.g. Cortex-M0) they must be provided by the toolchain.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_TASKS_H
+#define USHELL_TASKS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// if enabled, output from other tasks is collected per task and published by line
+#define USHELL_TASKS
+
+// number of tasks (or cores), which may output besides the shell (at most 31)
+#define USHELL_TASKS_COUNT          4
+
+// size of each task's line buffer (at most 255), longer lines are split,
+// while longer log lines are truncated
+#define USHELL_TASKS_LINE_LENGTH    128
+
+// size of the ring of published lines in bytes, must be a power of two (at most 32768)
+#define USHELL_TASKS_RING_SIZE      512
+
+/*
+ * Optional methods, which may be defined in the main code
+ *
+ * ushell_task_id() shall return 0 in the context, in which ushell_poll() is invoked,
+ * otherwise a number from 1 to USHELL_TASKS_COUNT unique to the calling task,
+ * e.g. its FreeRTOS task tag or the core number.
+ * Interrupt handlers, which output, need a number of their own.
+ *
+ * ushell_tasks_notify() is invoked after a task published a line,
+ * e.g. to wake the shell's task.
+ */
+extern uint8_t ushell_task_id();
+extern void ushell_tasks_notify();
+
+/**
+ * @brief Collect a character output by the calling task; invoked by the output functions
+ */
+void ushell_tasks_char(uint8_t c);
+
+/**
+ * @brief Mark the beginning and end of a log line output by the calling task
+ *
+ * A log line is published as a whole, once it ends;
+ * beyond USHELL_TASKS_LINE_LENGTH it is truncated and ends in "...".
+ */
+void ushell_tasks_begin_log();
+void ushell_tasks_end_log();
+
+/**
+ * @brief Publish a frame output by the calling task; invoked by ushell_output_frame()
+ *
+ * Frames longer than 255 bytes are dropped.
+ */
+void ushell_tasks_frame(uint8_t* data, uint16_t length);
+
+/**
+ * @brief Output the lines published by other tasks; invoked by ushell_poll()
+ */
+void ushell_tasks_poll();
+
+/**
+ * @brief Whether lines were published, but not yet output
+ */
+bool ushell_tasks_pending();
+
+#endif // USHELL_TASKS_H
@@ -0,0 +1,195 @@
+/**
+ * Telemetry streaming channel
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "telemetry.h"
+#include "ushell.h"
+
+
+// header length preceding the samples
+#define HEADER_LENGTH   8
+
+// space to reserve for one more sample and the CRC
+#define SAMPLE_MAX_LENGTH   5
+#define CRC_LENGTH          2
+
+/*
+ * Each channel is double-buffered:
+ * one frame is filled by the producer,
+ * while the other one awaits transmission.
+ */
+typedef struct
+{
+    uint8_t frame[2][USHELL_TELEMETRY_FRAME_SIZE];
+    uint8_t length[2];
+
+    // set by the producer, when a frame awaits transmission,
+    // cleared by ushell_telemetry_poll(), when the buffer is free again;
+    // one flag per buffer, so that neither side needs a read-modify-write
+    volatile bool ready[2];
+
+    // frame being filled; written before the ready flag upon handover
+    volatile uint8_t active;
+
+    int32_t previous;
+    uint8_t sequence;
+} telemetry_channel_t;
+
+telemetry_channel_t telemetry_channels[USHELL_TELEMETRY_CHANNELS];
+uint32_t telemetry_overruns = 0;
+
+
+void ushell_telemetry_push(uint8_t channel, int32_t sample)
+{
+    if (channel >= USHELL_TELEMETRY_CHANNELS)
+        return;
+
+    telemetry_channel_t* c = &telemetry_channels[channel];
+    uint8_t b = c->active;
+
+    // previous frame in this buffer not transmitted yet
+    if (c->ready[b])
+    {
+        telemetry_overruns++;
+        return;
+    }
+
+    uint8_t* f = c->frame[b];
+    uint8_t l = c->length[b];
+    uint32_t v;
+
+    if (l == 0)
+    {
+        // begin new frame
+        uint32_t now = ushell_uptime_ms();
+        f[0] = USHELL_TELEMETRY_TYPE_SAMPLES;
+        f[1] = channel;
+        f[2] = c->sequence++;
+        f[3] = 0;
+        f[4] = now;
+        f[5] = now >> 8;
+        f[6] = now >> 16;
+        f[7] = now >> 24;
+        l = HEADER_LENGTH;
+        v = sample;
+    }
+    else
+    {
+        v = (uint32_t) sample - (uint32_t) c->previous;
+    }
+    c->previous = sample;
+
+    // zigzag encoding maps small negative values to small positive ones
+    v = (v << 1) ^ (uint32_t) ((int32_t) v >> 31);
+
+    // LEB128
+    while (v >= 0x80)
+    {
+        f[l++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    f[l++] = v;
+    f[3]++;
+    c->length[b] = l;
+
+    // frame complete: hand it over and continue in the other buffer
+    if (l + SAMPLE_MAX_LENGTH + CRC_LENGTH > USHELL_TELEMETRY_FRAME_SIZE || f[3] == 0xFF)
+    {
+        c->active = b ^ 1;
+        c->ready[b] = true;
+    }
+}
+
+/**
+ * @brief Append CRC, COBS-encode and queue a frame for transmission
+ */
+void telemetry_send(uint8_t* payload, uint8_t length)
+{
+    uint16_t crc = crc16(0, payload, length);
+    payload[length++] = crc >> 8;
+    payload[length++] = crc & 0xFF;
+
+    // start byte + COBS overhead + end byte
+    uint8_t frame[USHELL_TELEMETRY_FRAME_SIZE + 3];
+    uint16_t l = 0;
+    frame[l++] = USHELL_TELEMETRY_FRAME_START;
+
+    // consistent overhead byte stuffing removes all zeros
+    uint16_t code_position = l++;
+    uint8_t code = 1;
+    for (uint8_t i=0; i<length; i++)
+    {
+        if (payload[i] == 0)
+        {
+            frame[code_position] = code;
+            code_position = l++;
+            code = 1;
+        }
+        else
+        {
+            frame[l++] = payload[i];
+            code++;
+        }
+    }
+    frame[code_position] = code;
+    frame[l++] = USHELL_TELEMETRY_FRAME_END;
+
+    ushell_output_frame(frame, l);
+}
+
+void ushell_telemetry_poll()
+{
+    for (uint8_t i=0; i<USHELL_TELEMETRY_CHANNELS; i++)
+    {
+        telemetry_channel_t* c = &telemetry_channels[i];
+
+        // while both frames await transmission, the producer stopped at the older one;
+        // a frame completed meanwhile is left for the next poll
+        bool ready[2] = { c->ready[0], c->ready[1] };
+        uint8_t first = (ready[0] && ready[1]) ? c->active : (ready[0] ? 0 : 1);
+        for (uint8_t k=0; k<2; k++)
+        {
+            uint8_t b = first ^ k;
+            if (!ready[b])
+                continue;
+
+            telemetry_send(c->frame[b], c->length[b]);
+
+            // release the buffer to the producer
+            c->length[b] = 0;
+            c->ready[b] = false;
+        }
+    }
+}
+
+bool ushell_telemetry_pending()
+{
+    for (uint8_t i=0; i<USHELL_TELEMETRY_CHANNELS; i++)
+        if (telemetry_channels[i].ready[0] || telemetry_channels[i].ready[1])
+            return true;
+    return false;
+}
+
+void ushell_telemetry_flush()
+{
+    for (uint8_t i=0; i<USHELL_TELEMETRY_CHANNELS; i++)
+    {
+        telemetry_channel_t* c = &telemetry_channels[i];
+        uint8_t b = c->active;
+        if (c->length[b] > 0 && !c->ready[b])
+        {
+            c->active = b ^ 1;
+            c->ready[b] = true;
+        }
+    }
+    ushell_telemetry_poll();
+}
+
+uint32_t ushell_telemetry_overruns()
+{
+    return telemetry_overruns;
+}
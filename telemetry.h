@@ -0,0 +1,73 @@
+/**
+ * Telemetry streaming channel
+ * ---------------------------------------------
+ *
+ * Applications push raw samples, which are batched per channel
+ * and sent as binary frames multiplexed with the text console.
+ * Use tools/telemetry on the host to separate them again.
+ *
+ * Frame format:
+ *   0x1E [COBS-encoded payload] 0x00
+ *
+ * Payload:
+ *   [type = 1] [channel] [sequence number] [sample count]
+ *   [time of first sample in ms, 4 bytes little endian]
+ *   [first sample] [difference to previous sample] ...
+ *   [CRC-16/XMODEM of all preceding payload bytes, 2 bytes big endian]
+ *
+ * Samples and differences are zigzag-encoded and stored as LEB128,
+ * so that slowly changing signals need about one byte per sample.
+ * Neither 0x1E nor 0x00 ever occur in text output.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_TELEMETRY_H
+#define USHELL_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// number of independent channels
+#define USHELL_TELEMETRY_CHANNELS   4
+
+// maximum payload size of one frame in bytes (at most 253)
+#define USHELL_TELEMETRY_FRAME_SIZE 64
+
+#define USHELL_TELEMETRY_FRAME_START    0x1E
+#define USHELL_TELEMETRY_FRAME_END      0x00
+#define USHELL_TELEMETRY_TYPE_SAMPLES   1
+
+/**
+ * @brief Append a sample to a channel's current frame
+ *
+ * May be invoked from interrupt context; completed frames
+ * are transmitted by ushell_poll(). If the previous frame
+ * has not been transmitted yet, the sample is discarded.
+ */
+void ushell_telemetry_push(uint8_t channel, int32_t sample);
+
+/**
+ * @brief Transmit all completed frames; invoked by ushell_poll()
+ */
+void ushell_telemetry_poll();
+
+/**
+ * @brief Complete and transmit all partially filled frames
+ *
+ * Must not be invoked while samples are pushed concurrently.
+ */
+void ushell_telemetry_flush();
+
+/**
+ * @brief Whether completed frames await transmission by ushell_telemetry_poll()
+ */
+bool ushell_telemetry_pending();
+
+/**
+ * @brief Number of samples discarded, because frames could not be transmitted in time
+ */
+uint32_t ushell_telemetry_overruns();
+
+#endif // USHELL_TELEMETRY_H
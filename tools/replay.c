@@ -0,0 +1,282 @@
+/**
+ * Replay a recorded keystroke trace on the host
+ * ---------------------------------------------
+ *
+ * Feeds a trace recorded with ushell_record_start()
+ * through ushell_input_char() and reports
+ * input throughput, output volume and time spent per command.
+ *
+ * Between two input bytes the shell is idle: The replay emulates
+ * a main loop sleeping until ushell_next_deadline()
+ * and reports how often it had to wake up.
+ *
+ * Usage: replay [-r] [-v] <trace file>
+ *   -r: replay at the original pace instead of as fast as possible
+ *   -v: print the shell's output
+ *
+ * To replay against your own applications,
+ * link an object file defining:
+ *   ushell_app_list_t replay_apps
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ushell.h"
+#include "recorder.h"
+
+// maximum number of distinct commands to report on
+#define MAX_COMMANDS    64
+
+extern char command_line[];
+
+// applications to replay against, if none are linked
+__attribute__((weak)) ushell_app_list_t replay_apps = { .count = 0 };
+
+bool verbose = false;
+uint64_t output_bytes = 0;
+
+typedef struct
+{
+    char name[MAX_LENGTH];
+    uint32_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t output_bytes;
+} command_statistics_t;
+
+command_statistics_t commands[MAX_COMMANDS];
+uint8_t command_count = 0;
+
+
+void terminal_output_char(uint8_t c)
+{
+    output_bytes++;
+    if (verbose)
+        putchar(c);
+}
+
+uint16_t terminal_output_buffer(uint8_t* data, uint16_t length)
+{
+    output_bytes += length;
+    if (verbose)
+        fwrite(data, 1, length, stdout);
+    return length;
+}
+
+uint64_t cpu_time_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Find or create the statistics entry of a command
+ */
+command_statistics_t* command_statistics(char* line)
+{
+    // the first word names the command
+    char name[MAX_LENGTH];
+    uint8_t l = 0;
+    while (line[l] != '\0' && line[l] != ' ' && l < MAX_LENGTH-1)
+    {
+        name[l] = line[l];
+        l++;
+    }
+    name[l] = '\0';
+    if (l == 0)
+        return 0;
+
+    for (uint8_t i=0; i<command_count; i++)
+        if (strcmp(commands[i].name, name) == 0)
+            return &commands[i];
+
+    if (command_count >= MAX_COMMANDS)
+        return 0;
+
+    command_statistics_t* c = &commands[command_count++];
+    strcpy(c->name, name);
+    return c;
+}
+
+/**
+ * @brief Decode an LEB128-encoded time delta
+ */
+bool read_delta(uint8_t* trace, long size, long* position, uint32_t* delta)
+{
+    *delta = 0;
+    for (uint8_t shift=0; shift<32; shift+=7)
+    {
+        if (*position >= size)
+            return false;
+        uint8_t b = trace[(*position)++];
+        *delta |= (uint32_t) (b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    bool realtime = false;
+    char* filename = 0;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0)
+            realtime = true;
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            filename = argv[i];
+    }
+
+    if (filename == 0)
+    {
+        fprintf(stderr, "Usage: %s [-r] [-v] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    // load trace
+    FILE* f = fopen(filename, "rb");
+    if (f == 0)
+    {
+        perror(filename);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* trace = malloc(size);
+    if (trace == 0 || fread(trace, 1, size, f) != (size_t) size)
+    {
+        fprintf(stderr, "Failed to read %s\n", filename);
+        return 1;
+    }
+    fclose(f);
+
+    if (size < 6
+     || memcmp(trace, USHELL_TRACE_MAGIC, 4) != 0
+     || trace[4] != USHELL_TRACE_VERSION)
+    {
+        fprintf(stderr, "%s is not a trace of version %d\n", filename, USHELL_TRACE_VERSION);
+        return 1;
+    }
+
+    ushell_init(&replay_apps);
+
+    uint64_t input_bytes = 0;
+    uint64_t input_ns = 0;
+    uint64_t trace_ms = 0;
+    uint64_t timer_wakeups = 0;
+    uint64_t start_ns = cpu_time_ns();
+
+    long position = 6;
+    while (position < size)
+    {
+        uint32_t delta;
+        if (!read_delta(trace, size, &position, &delta) || position >= size)
+        {
+            fprintf(stderr, "Truncated record at offset %ld\n", position);
+            break;
+        }
+        uint8_t b = trace[position++];
+
+        // advance the shell's time base as during recording
+        if (realtime && delta > 0)
+        {
+            struct timespec t = { delta / 1000, (delta % 1000) * 1000000l };
+            nanosleep(&t, 0);
+        }
+        uint32_t idle = delta;
+        while (true)
+        {
+            while (ushell_poll())
+                ;
+
+            // sleep until the next deadline or the next input byte
+            uint32_t sleep = idle;
+            uint32_t deadline = ushell_next_deadline();
+            if (deadline != USHELL_NO_DEADLINE)
+            {
+                int32_t until = deadline - ushell_uptime_ms();
+                if (until < USHELL_TICK_MS)
+                    until = USHELL_TICK_MS;
+                if ((uint32_t) until < sleep)
+                    sleep = until;
+            }
+            ushell_advance(sleep);
+            idle -= sleep;
+            if (idle == 0)
+                break;
+            timer_wakeups++;
+        }
+        trace_ms += delta;
+
+        // attribute time and output to the command being submitted
+        command_statistics_t* c = 0;
+        if (b == KEY_ENTER)
+            c = command_statistics(command_line);
+
+        uint64_t output_before = output_bytes;
+        uint64_t t0 = cpu_time_ns();
+        ushell_input_char(b);
+        uint64_t dt = cpu_time_ns() - t0;
+
+        input_bytes++;
+        input_ns += dt;
+
+        if (c != 0)
+        {
+            c->count++;
+            c->total_ns += dt;
+            if (dt > c->max_ns)
+                c->max_ns = dt;
+            c->output_bytes += output_bytes - output_before;
+        }
+    }
+    ushell_output_flush();
+
+    uint64_t total_ns = cpu_time_ns() - start_ns;
+
+    // report
+    fprintf(stderr, "\n");
+    fprintf(stderr, "input bytes:      %llu\n", (unsigned long long) input_bytes);
+    fprintf(stderr, "output bytes:     %llu\n", (unsigned long long) output_bytes);
+    fprintf(stderr, "trace duration:   %llu ms\n", (unsigned long long) trace_ms);
+    fprintf(stderr, "wakeups:          %llu (%llu by input, %llu by deadlines)\n",
+            (unsigned long long) (input_bytes + timer_wakeups),
+            (unsigned long long) input_bytes,
+            (unsigned long long) timer_wakeups);
+    if (trace_ms > 0)
+        fprintf(stderr, "wakeups per second: %.2f (%.2f by deadlines)\n",
+                (input_bytes + timer_wakeups) * 1000.0 / trace_ms,
+                timer_wakeups * 1000.0 / trace_ms);
+    fprintf(stderr, "total CPU time:   %llu us\n", (unsigned long long) total_ns/1000);
+    fprintf(stderr, "input CPU time:   %llu us\n", (unsigned long long) input_ns/1000);
+    if (input_ns > 0)
+        fprintf(stderr, "input throughput: %.0f bytes/s\n", input_bytes * 1e9 / input_ns);
+
+    fprintf(stderr, "\n%-20s %8s %12s %12s %12s\n", "command", "count", "avg [us]", "max [us]", "output [B]");
+    for (uint8_t i=0; i<command_count; i++)
+    {
+        command_statistics_t* c = &commands[i];
+        fprintf(stderr, "%-20s %8u %12.1f %12.1f %12llu\n",
+                c->name,
+                c->count,
+                c->total_ns / 1000.0 / c->count,
+                c->max_ns / 1000.0,
+                (unsigned long long) c->output_bytes);
+    }
+
+    free(trace);
+    return 0;
+}
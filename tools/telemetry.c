@@ -0,0 +1,167 @@
+/**
+ * Separate telemetry frames from console text on the host
+ * ---------------------------------------------
+ *
+ * Reads the device's output from stdin,
+ * passes console text through to stderr
+ * and writes all telemetry samples as CSV to stdout:
+ *   time [ms],index,channel,value
+ * where time is the time of the frame's first sample
+ * and index the sample's position within the frame.
+ *
+ * Example:
+ *   tools/telemetry < /dev/ttyUSB0 > samples.csv
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "helper.h"
+#include "telemetry.h"
+
+// longest COBS-encoded frame accepted
+#define MAX_FRAME   256
+
+// sequence number expected next per channel, -1 if unknown
+int expected_sequence[256];
+
+
+void terminal_output_char(uint8_t c)
+{
+}
+
+/**
+ * @brief Decode a COBS-encoded frame in-place
+ * @return Decoded length or -1, if the frame is malformed
+ */
+int cobs_decode(uint8_t* frame, int length)
+{
+    int r = 0;
+    int w = 0;
+    while (r < length)
+    {
+        uint8_t code = frame[r++];
+        if (code == 0 || r + code - 1 > length)
+            return -1;
+        for (uint8_t i=1; i<code; i++)
+            frame[w++] = frame[r++];
+        if (code < 0xFF && r < length)
+            frame[w++] = 0;
+    }
+    return w;
+}
+
+/**
+ * @brief Decode a LEB128 value
+ */
+bool read_leb128(uint8_t* data, int length, int* position, uint32_t* value)
+{
+    *value = 0;
+    for (uint8_t shift=0; shift<35; shift+=7)
+    {
+        if (*position >= length)
+            return false;
+        uint8_t b = data[(*position)++];
+        *value |= (uint32_t) (b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void handle_frame(uint8_t* frame, int length)
+{
+    length = cobs_decode(frame, length);
+    if (length < 8 + 2)
+    {
+        fprintf(stderr, "[telemetry] malformed frame\n");
+        return;
+    }
+
+    uint16_t crc = (frame[length-2] << 8) | frame[length-1];
+    length -= 2;
+    if (crc16(0, frame, length) != crc)
+    {
+        fprintf(stderr, "[telemetry] CRC error\n");
+        return;
+    }
+
+    if (frame[0] != USHELL_TELEMETRY_TYPE_SAMPLES)
+        return;
+
+    uint8_t channel = frame[1];
+    uint8_t sequence = frame[2];
+    uint8_t count = frame[3];
+    uint32_t time = frame[4] | (frame[5] << 8) | (frame[6] << 16) | ((uint32_t) frame[7] << 24);
+
+    if (expected_sequence[channel] >= 0 && sequence != expected_sequence[channel])
+        fprintf(stderr, "[telemetry] channel %u: %u frames lost\n", channel, (uint8_t) (sequence - expected_sequence[channel]));
+    expected_sequence[channel] = (uint8_t) (sequence + 1);
+
+    int position = 8;
+    int32_t sample = 0;
+    for (uint8_t i=0; i<count; i++)
+    {
+        uint32_t v;
+        if (!read_leb128(frame, length, &position, &v))
+        {
+            fprintf(stderr, "[telemetry] truncated frame\n");
+            return;
+        }
+
+        // undo zigzag encoding, then accumulate differences
+        int32_t d = (int32_t) ((v >> 1) ^ -(v & 1));
+        sample = (i == 0) ? d : (int32_t) ((uint32_t) sample + (uint32_t) d);
+        printf("%u,%u,%u,%d\n", time, i, channel, sample);
+    }
+    fflush(stdout);
+}
+
+int main()
+{
+    for (int i=0; i<256; i++)
+        expected_sequence[i] = -1;
+
+    uint8_t frame[MAX_FRAME];
+    int length = 0;
+    bool inside_frame = false;
+
+    int c;
+    while ((c = getchar()) != EOF)
+    {
+        if (!inside_frame)
+        {
+            if (c == USHELL_TELEMETRY_FRAME_START)
+            {
+                inside_frame = true;
+                length = 0;
+            }
+            else
+            {
+                fputc(c, stderr);
+            }
+            continue;
+        }
+
+        if (c == USHELL_TELEMETRY_FRAME_END)
+        {
+            handle_frame(frame, length);
+            inside_frame = false;
+        }
+        else if (length < MAX_FRAME)
+        {
+            frame[length++] = c;
+        }
+        else
+        {
+            fprintf(stderr, "[telemetry] oversized frame\n");
+            inside_frame = false;
+        }
+    }
+
+    return 0;
+}
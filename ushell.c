@@ -6,21 +6,48 @@
  * License: GNU GPLv3
  */
 
+#include <stdlib.h>  // bsearch()
+
 #include "ushell.h"
 #include "syslog.h"
+#include "watch.h"
+#include "alias.h"
+#include "variable.h"
+#include "recorder.h"
+#include "dump.h"
+#include "receive.h"
+#include "telemetry.h"
+#include "completion.h"
+#include "scratch.h"
+#include "pager.h"
+#include "coroutine.h"
+#include "schedule.h"
+#include "scrollback.h"
+#include "highlight.h"
+#include "tasks.h"
 
 
 // length of current command line
 uint8_t length = 0;
 // command line string
 char command_line[MAX_LENGTH];
-char last_command_line[MAX_LENGTH];
 
 // whether to echo received characters back to terminal
 bool ushell_echo = true;
 
 // helper macro to empty the command line
+#ifdef USHELL_HIGHLIGHT
+#define clear_command_line()  length = 0; command_line[0] = '\0'; ushell_highlight_line(command_line);
+#else
 #define clear_command_line()  length = 0; command_line[0] = '\0';
+#endif
+
+// helper macro to output the command line
+#ifdef USHELL_HIGHLIGHT
+#define write_command_line()  ushell_highlight_write(command_line);
+#else
+#define write_command_line()  write(command_line);
+#endif
 
 
 // private command setup
@@ -29,6 +56,29 @@ ushell_app_list_t* ushell_app_list = 0;
 // currently running application's input handler
 keystroke_handler_t current_keystroke_handler = 0;
 
+// whether log messages overwrote the prompt
+bool prompt_redraw_pending = false;
+
+// exit status of the most recently executed command
+int ushell_status = 0;
+
+// time base, advanced by ushell_tick()
+volatile uint32_t ushell_milliseconds = 0;
+
+// buffer capturing the output of ushell_exec()
+char* exec_output = 0;
+uint16_t exec_size = 0;
+uint16_t exec_length = 0;
+
+// received bytes queued by ushell_input_queue()
+uint8_t input_queue[USHELL_INPUT_QUEUE_SIZE];
+volatile uint8_t input_queue_head = 0;
+volatile uint8_t input_queue_tail = 0;
+uint32_t input_overruns = 0;
+
+// output.c
+extern output_handler_t current_output_handler;
+
 
 // fallback routine, if no other method is implemented
 __attribute__((weak)) void terminal_output_string(char* s)
@@ -41,13 +91,109 @@ __attribute__((weak)) void terminal_output_string(char* s)
 
 inline void ushell_init(ushell_app_list_t* config)
 {
+    // applications may as well be registered using USHELL_COMMAND()
     ushell_app_list = config;
-    // Determine app count automatically
-//    ushell_app_list->count = sizeof(config->apps)/sizeof(config->apps[0]);
     setvbuf(stdout, NULL, _IONBF, 0);
     clear_command_line();
 }
 
+void ushell_tick()
+{
+    ushell_advance(USHELL_TICK_MS);
+}
+
+void ushell_advance(uint32_t milliseconds)
+{
+    ushell_milliseconds += milliseconds;
+    ushell_output_tick(milliseconds);
+}
+
+uint32_t ushell_uptime_ms()
+{
+    return ushell_milliseconds;
+}
+
+bool ushell_poll()
+{
+    // input received in interrupt context
+    while (input_queue_tail != input_queue_head)
+    {
+        uint8_t c = input_queue[input_queue_tail % USHELL_INPUT_QUEUE_SIZE];
+        input_queue_tail++;
+        ushell_input_char(c);
+    }
+
+    // continue coroutines, whose input arrived or sleep elapsed
+    ushell_coroutine_poll();
+
+    // re-run watched command, if due
+    ushell_watch_poll();
+
+    // commands scheduled by every and after,
+    // deferred while their output would corrupt a transfer
+    if (!ushell_receiving())
+        ushell_schedule_poll();
+
+    // binary transfer timeouts
+    ushell_receive_poll();
+
+    // completed telemetry frames
+    ushell_telemetry_poll();
+
+    #ifdef USHELL_TASKS
+    // lines output by other tasks, kept back during a transfer
+    if (!ushell_receiving())
+        ushell_tasks_poll();
+    #endif
+
+    // reprint prompt after log messages
+    ushell_prompt_redraw();
+
+    // transmit output queued while the link was stalled
+    ushell_output_flush();
+
+    return ushell_pending();
+}
+
+bool ushell_pending()
+{
+    return input_queue_tail != input_queue_head
+        || ushell_telemetry_pending()
+        || ushell_coroutine_pending()
+        #ifdef USHELL_TASKS
+        || (ushell_tasks_pending() && !ushell_receiving())
+        #endif
+        || (ushell_output_pending() && !ushell_output_stalled())
+        || (prompt_redraw_pending && current_keystroke_handler == 0);
+}
+
+/**
+ * @brief Earlier of two deadlines, either of which may be USHELL_NO_DEADLINE
+ */
+uint32_t deadline_min(uint32_t a, uint32_t b, uint32_t now)
+{
+    if (a == USHELL_NO_DEADLINE)
+        return b;
+    if (b == USHELL_NO_DEADLINE)
+        return a;
+    // compare relative to now, as the time base wraps around
+    return ((int32_t) (a - now) < (int32_t) (b - now)) ? a : b;
+}
+
+uint32_t ushell_next_deadline()
+{
+    uint32_t now = ushell_uptime_ms();
+    if (ushell_pending())
+        return now;
+
+    uint32_t deadline = ushell_watch_deadline();
+    deadline = deadline_min(deadline, ushell_receive_deadline(), now);
+    deadline = deadline_min(deadline, ushell_coroutine_deadline(), now);
+    if (!ushell_receiving())
+        deadline = deadline_min(deadline, ushell_schedule_deadline(), now);
+    return deadline;
+}
+
 inline void ushell_echo_on()
 {
     ushell_echo = true;
@@ -60,6 +206,7 @@ inline void ushell_echo_off()
 
 inline void ushell_prompt()
 {
+    prompt_redraw_pending = false;
     write(
         ANSI_RESET
         ANSI_FG_CYAN
@@ -71,6 +218,15 @@ inline void ushell_prompt()
         );
 }
 
+void ushell_prompt_redraw()
+{
+    if (!prompt_redraw_pending || current_keystroke_handler != 0)
+        return;
+
+    ushell_prompt();
+    write_command_line();
+}
+
 inline void ushell_prompt_suspend()
 {
     current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
@@ -81,153 +237,672 @@ inline void ushell_prompt_resume()
     current_keystroke_handler = (keystroke_handler_t) 0;
 }
 
-void ushell_help()
-{
-    // command list undefined
-    if (ushell_app_list == 0)
-        return;
-
-    const uint8_t width_column1 = 30;
-    const uint8_t width_column2 = 55;
+// width of the help table's columns
+#define HELP_WIDTH_COLUMN1  30
+#define HELP_WIDTH_COLUMN2  55
 
-    // upper table border
+/**
+ * @brief Print upper or lower border of the help table
+ */
+void help_border()
+{
     writec('+');
-    for (uint8_t i=0; i<width_column1; i++)
+    for (uint8_t i=0; i<HELP_WIDTH_COLUMN1; i++)
         writec('-');
     writec('+');
-    for (uint8_t i=0; i<width_column2; i++)
+    for (uint8_t i=0; i<HELP_WIDTH_COLUMN2; i++)
         writec('-');
     writec('+');
     crlf();
+}
+
+void ushell_help_row(char* name, char* text)
+{
+    if (name == 0)
+        name = "NULL";
+    if (text == 0)
+        text = "NULL";
+
+    write("| ");
+    write(name);
+    for (uint8_t j=1+strlen(name); j<HELP_WIDTH_COLUMN1; j++)
+        writec(' ');
+    write("| ");
+    write(text);
+    for (uint8_t j=1+strlen(text); j<HELP_WIDTH_COLUMN2; j++)
+        writec(' ');
+    writec('|');
+    crlf();
+}
+
+/**
+ * @brief Print help text for a command and, if it is a group, its subcommands
+ */
+void help_group(ushell_app_t* app)
+{
+    help_border();
+    ushell_help_row(app->name, app->help_brief);
+    for (uint16_t i=0; app->children != 0 && i<app->children->count; i++)
+    {
+        // indent subcommands
+        char name[HELP_WIDTH_COLUMN1];
+        name[0] = ' ';
+        name[1] = ' ';
+        strncpy(&name[2], app->children->apps[i].name, sizeof(name)-3);
+        name[sizeof(name)-1] = '\0';
+        ushell_help_row(name, app->children->apps[i].help_brief);
+    }
+    help_border();
+}
+
+/**
+ * @brief Built-in command: help [command [subcommand ...]]
+ */
+int help_command(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    ushell_pager_start();
+    if (argc < 2)
+    {
+        ushell_help();
+        return USHELL_STATUS_SUCCESS;
+    }
+
+    // help scoped to a command (group)
+    ushell_app_t* app = ushell_find_app(argv[1]);
+    if (app == 0 || ushell_find_subcommand(&app, argc-1, &argv[1]) < argc-2)
+    {
+        log_error("Command not recognized");
+        return USHELL_STATUS_FAILURE;
+    }
+    help_group(app);
+    return USHELL_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Built-in command: clear
+ */
+int clear_command(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    ushell_clear();
+    return USHELL_STATUS_SUCCESS;
+}
+
+// commands implemented by the shell itself
+const ushell_app_t ushell_builtins[] =
+{
+    { "help",       &help_command,      "Show this help" },
+    { "clear",      &clear_command,     "Clear screen" },
+    { "watch",      &ushell_watch,      "Periodically re-execute a command" },
+    { "alias",      &ushell_alias,      "Define or list aliases" },
+    { "unalias",    &ushell_unalias,    "Remove an alias" },
+    { "set",        &ushell_set,        "Set or list variables" },
+    { "unset",      &ushell_unset,      "Remove a variable" },
+    { "md",         &ushell_md,         "Dump memory: md <address> [length]" },
+    { "hexdump",    &ushell_md,         "Dump memory, same as md" },
+    { "scratch",    &ushell_scratch,    "Show scratch memory usage" },
+    { "every",      &ushell_every,      "Repeat a command: every <period> <command>" },
+    { "after",      &ushell_after,      "Run a command later: after <delay> <command>" },
+    { "jobs",       &ushell_jobs,       "List scheduled commands" },
+    { "kill",       &ushell_kill,       "Cancel a scheduled command: kill <job>" },
+    #ifdef USHELL_SCROLLBACK
+    { "scrollback", &ushell_scrollback, "Show recent output: scrollback [lines]" },
+    { "grep",       &ushell_grep,       "Search recent output: grep <pattern> scrollback" },
+    #endif
+};
+#define BUILTIN_COUNT   (sizeof(ushell_builtins)/sizeof(ushell_builtins[0]))
+const uint8_t ushell_builtin_count = BUILTIN_COUNT;
+
+/**
+ * @brief Find the built-in command with the given name
+ */
+const ushell_app_t* builtin_find(char* name)
+{
+    for (uint8_t i=0; i<BUILTIN_COUNT; i++)
+        if (strcmp(name, ushell_builtins[i].name) == 0)
+            return &ushell_builtins[i];
+    return 0;
+}
+
+/**
+ * @brief Number of applications registered using USHELL_COMMAND()
+ */
+uint16_t registry_count()
+{
+    return __stop_ushell_commands - __start_ushell_commands;
+}
+
+uint16_t ushell_app_count()
+{
+    uint16_t count = registry_count();
+    if (ushell_app_list != 0)
+        count += ushell_app_list->count;
+    return count;
+}
+
+ushell_app_t* ushell_app(uint16_t i)
+{
+    if (ushell_app_list != 0)
+    {
+        if (i < ushell_app_list->count)
+            return &ushell_app_list->apps[i];
+        i -= ushell_app_list->count;
+    }
+    return (ushell_app_t*) &__start_ushell_commands[i];
+}
+
+void ushell_help()
+{
+    help_border();
+
+    // print help text for built-in commands
+    for (uint8_t i=0; i<BUILTIN_COUNT; i++)
+    {
+        // a help text may be configured in the command list
+        char* help = ushell_builtins[i].help_brief;
+        for (uint16_t j=0; ushell_app_list != 0 && j<ushell_app_list->count; j++)
+        {
+            ushell_app_t* app = &ushell_app_list->apps[j];
+            if (app->name != 0 && strcmp(app->name, ushell_builtins[i].name) == 0)
+                help = app->help_brief;
+        }
+        ushell_help_row(ushell_builtins[i].name, help);
+    }
 
     // print help text for all available programs
-    for (uint8_t i=0; i<ushell_app_list->count; i++)
+    for (uint16_t i=0; i<ushell_app_count(); i++)
+    {
+        ushell_app_t* app = ushell_app(i);
+        if (app->name != 0 && builtin_find(app->name) != 0)
+            continue;
+        ushell_help_row(app->name, app->help_brief);
+    }
+
+    // print user-defined aliases
+    ushell_alias_help();
+
+    help_border();
+}
+
+/**
+ * @brief Compare function for searching the command registry
+ */
+int registry_compare(const void* name, const void* app)
+{
+    return strcmp((const char*) name, ((const ushell_app_t*) app)->name);
+}
+
+ushell_app_t* ushell_find_app(char* name)
+{
+    // search command list
+    for (uint8_t i=0; ushell_app_list != 0 && i<ushell_app_list->count; i++)
     {
         ushell_app_t* app = &ushell_app_list->apps[i];
-        char* s;
-        uint8_t x;
 
-        write("| ");
-        if (app->name != 0)
+        if (app->name != 0
+         && (app->function != 0 || app->children != 0)
+         && strcmp(name, app->name) == 0)
         {
-            s = app->name;
-            x = strlen(app->name);
+            return app;
         }
-        else
+    }
+
+    // search registry, which is sorted by the linker
+    if (registry_count() == 0)
+        return 0;
+    return (ushell_app_t*) bsearch(
+            name,
+            __start_ushell_commands,
+            registry_count(),
+            sizeof(ushell_app_t),
+            &registry_compare
+            );
+}
+
+ushell_app_t* ushell_find_child(const ushell_group_t* group, char* name)
+{
+    if (group == 0 || group->count == 0)
+        return 0;
+    return (ushell_app_t*) bsearch(
+            name,
+            group->apps,
+            group->count,
+            sizeof(ushell_app_t),
+            &registry_compare
+            );
+}
+
+uint8_t ushell_find_subcommand(ushell_app_t** app, uint8_t argc, char* argv[])
+{
+    // one binary search per level
+    uint8_t depth = 0;
+    ushell_app_t* child;
+    while (depth+1 < argc
+        && (child = ushell_find_child((*app)->children, argv[depth+1])) != 0)
+    {
+        *app = child;
+        depth++;
+    }
+    return depth;
+}
+
+uint8_t ushell_tokenize(char* s, char* argv[], uint8_t max, char* expansion, uint16_t size)
+{
+    uint8_t argc = 0;
+
+    // quotes are removed in-place, thus write trails read position
+    char* r = s;
+    char* w = s;
+
+    // substrings containing variables are copied to the expansion buffer
+    char* e = expansion;
+    char* expansion_end = expansion + size;
+
+    while (true)
+    {
+        // skip separators
+        while (*r == ' ')
+            r++;
+        if (*r == '\0')
+            break;
+
+        // cannot have more than max substrings
+        if (argc >= max)
         {
-            s = "NULL";
-            x = 4;
+            log_warning("More than " STR(MAX_SUBSTRINGS) " arguments will be ignored.");
+            break;
         }
-        write(s);
-        for (uint8_t j=1+x; j<width_column1; j++)
-            writec(' ');
-        write("| ");
-        if (app->help_brief[i] != 0)
+        argv[argc++] = w;
+        bool expanded = false;
+
+        // copy substring until next unquoted separator
+        char quote = 0;
+        while (*r != '\0')
         {
-            s = app->help_brief;
-            x = strlen(app->help_brief);
+            if (quote != 0)
+            {
+                if (*r == quote)
+                {
+                    quote = 0;
+                    r++;
+                    continue;
+                }
+            }
+            else if (*r == '\'' || *r == '"')
+            {
+                quote = *r++;
+                continue;
+            }
+            else if (*r == ' ')
+            {
+                break;
+            }
+
+            // substitute variables, except within single quotes
+            char* value;
+            char* next;
+            if (*r == '$'
+             && quote != '\''
+             && expansion != 0
+             && (expanded || e < expansion_end)
+             && (next = ushell_variable_reference(r, &value)) != r)
+            {
+                if (!expanded)
+                {
+                    // move the substring's beginning to the expansion buffer
+                    uint16_t n = w - argv[argc-1];
+                    if (n > expansion_end - e - 1)
+                        n = expansion_end - e - 1;
+                    memcpy(e, argv[argc-1], n);
+                    argv[argc-1] = e;
+                    e += n;
+                    expanded = true;
+                }
+                while (*value != '\0' && e < expansion_end-1)
+                    *e++ = *value++;
+                r = next;
+                continue;
+            }
+
+            if (expanded)
+            {
+                if (e < expansion_end-1)
+                    *e++ = *r;
+                r++;
+            }
+            else
+            {
+                *w++ = *r++;
+            }
         }
+
+        // insert string terminator
+        char separator = *r;
+        if (expanded)
+            *e++ = '\0';
         else
-        {
-            s = "NULL";
-            x = 4;
-        }
-        write(s);
-        for (uint8_t j=1+x; j<width_column2; j++)
-            writec(' ');
-        writec('|');
-        crlf();
+            *w++ = '\0';
+        if (separator == '\0')
+            break;
+        r++;
     }
 
-    // lower table border
-    writec('+');
-    for (uint8_t i=0; i<width_column1; i++)
-        writec('-');
-    writec('+');
-    for (uint8_t i=0; i<width_column2; i++)
-        writec('-');
-    writec('+');
-    crlf();
+    return argc;
+}
+
+int ushell_last_status()
+{
+    return ushell_status;
 }
 
 /**
- * @brief Command input evaluator
- * Run, whenever the user hits the ENTER key.
- *
- * This function cannot be inline, since it contains the static variable enabled_previously.
+ * @brief Output the commands closest to an unrecognized name
+ * @param group: Command group to search, 0 for the top level
  */
-void command_line_evaluator()
+void suggest_commands(char* name, const ushell_group_t* group)
 {
-    // empty input ?
-    if (command_line[0] == '\0')
+    // too large for the stack of small targets
+    static edit_pattern_t pattern;
+    if (!edit_pattern(&pattern, name) || pattern.length == 0)
         return;
 
-    // split input into substrings
-    uint8_t cc = 1;
-    char* cv[MAX_SUBSTRINGS];
-    cv[0] = command_line;
+    // short names would be similar to almost anything
+    uint8_t max = USHELL_SUGGEST_DISTANCE;
+    if (max >= pattern.length)
+        max = pattern.length - 1;
+
+    // best suggestions so far, ordered by distance
+    const char* suggestion[USHELL_SUGGESTIONS];
+    uint8_t distance[USHELL_SUGGESTIONS];
+    uint8_t count = 0;
+
+    uint16_t n = (group != 0) ? group->count : BUILTIN_COUNT+ushell_app_count();
+    for (uint16_t i=0; i<n; i++)
+    {
+        const ushell_app_t* app;
+        if (group != 0)
+            app = &group->apps[i];
+        else
+            app = (i < BUILTIN_COUNT) ? &ushell_builtins[i] : ushell_app(i-BUILTIN_COUNT);
+        if (app->name == 0)
+            continue;
 
-    for (uint8_t i=1; i<MAX_LENGTH; i++)
-        if (
-            command_line[i] == ' '
-         || command_line[i] == '='
-            )
+        uint8_t d = edit_distance(&pattern, app->name, max);
+        if (d > max)
+            continue;
+
+        // insert in order, dropping the worst suggestion
+        uint8_t j = (count < USHELL_SUGGESTIONS) ? count++ : USHELL_SUGGESTIONS;
+        while (j > 0 && distance[j-1] > d)
         {
-            // insert string terminator
-            command_line[i] = '\0';
-            // begin next command part after the terminator
-            cv[cc] = &command_line[i+1];
-            // increment command count
-            cc++;
-            // cannot have more than MAX_SUBSTRINGS
-            if (cc >= MAX_SUBSTRINGS)
+            if (j < USHELL_SUGGESTIONS)
             {
-                log_warning("More than " STR(MAX_SUBSTRINGS) " arguments will be ignored.");
-                break;
+                suggestion[j] = suggestion[j-1];
+                distance[j] = distance[j-1];
             }
+            j--;
         }
+        if (j < USHELL_SUGGESTIONS)
+        {
+            suggestion[j] = app->name;
+            distance[j] = d;
+        }
+    }
 
-    // help
-    if (strcmp(cv[0], "?") == 0
-     || strcmp(cv[0], "h") == 0
-     || strcmp(cv[0], "help") == 0)
-    {
-        ushell_help();
+    if (count == 0)
         return;
+    write("Did you mean: ");
+    for (uint8_t i=0; i<count; i++)
+    {
+        if (i > 0)
+            write(", ");
+        write((char*) suggestion[i]);
     }
+    writeln("?");
+}
 
-    // clear
-    if (strcmp(cv[0], "clear") == 0)
+/**
+ * @brief Release an application's scratch memory, unless it remains running
+ * @param handler: Keystroke handler before the application was invoked
+ */
+void invocation_end(ushell_context_t* context, keystroke_handler_t handler)
+{
+    if (context == 0)
+        return;
+
+    if (current_keystroke_handler != handler
+     && current_keystroke_handler != USHELL_KEYSTROKE_HANDLER_DUMMY)
     {
-        ushell_clear();
+        // released by ushell_release_keystroke_handler()
+        context->running = true;
         return;
     }
+    ushell_scratch_end(context);
+}
+
+int ushell_execute(uint8_t argc, char* argv[])
+{
+    // help shortcuts, paged like help
+    if (strcmp(argv[0], "?") == 0
+     || strcmp(argv[0], "h") == 0)
+    {
+        argv[0] = (char*) "help";
+    }
+
+    // built-in commands
+    const ushell_app_t* builtin = builtin_find(argv[0]);
+    if (builtin != 0)
+    {
+        keystroke_handler_t handler = current_keystroke_handler;
+        ushell_context_t* context = ushell_scratch_begin(builtin->name);
+        ushell_status = (*(builtin->function))(argc, argv, context);
+        invocation_end(context, handler);
+        return ushell_status;
+    }
+
+    // variable assignment
+    if (ushell_variable_assignment(argc, argv))
+        return ushell_status;
+
+    // user-defined alias
+    if (ushell_alias_expand(argc, argv))
+        return ushell_status;
 
     // search command setup for matching command
-    for (uint8_t i=0; i<ushell_app_list->count; i++)
+    ushell_app_t* app = ushell_find_app(argv[0]);
+    if (app != 0)
     {
-        ushell_app_t* app = &ushell_app_list->apps[i];
+        // descend into command groups, the subcommand becomes argv[0]
+        uint8_t depth = ushell_find_subcommand(&app, argc, argv);
+        argc -= depth;
+        argv += depth;
 
-        if (app->name != 0
-         && app->function != 0
-         && strcmp(cv[0], app->name) == 0)
+        // a group without function of its own
+        if (app->function == 0)
         {
-            // command found
-            // set dummy keystroke handler to prevent syslog problems
-            current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
-            // execute developer-configured function
-            (*(app->function))(cc, cv);
-            // clear dummy keystroke handler
-            if (current_keystroke_handler == USHELL_KEYSTROKE_HANDLER_DUMMY)
-                current_keystroke_handler = 0;
-            return;
+            if (argc == 1)
+            {
+                help_group(app);
+                ushell_status = USHELL_STATUS_SUCCESS;
+                return ushell_status;
+            }
+            ushell_status = USHELL_STATUS_NOT_FOUND;
+            log_error("Subcommand not recognized");
+            writeln(argv[1]);
+            suggest_commands(argv[1], app->children);
+            return ushell_status;
         }
+
+        // command found
+        // set dummy keystroke handler to prevent syslog problems
+        keystroke_handler_t handler = current_keystroke_handler;
+        current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
+        // execute developer-configured function
+        ushell_context_t* context = ushell_scratch_begin(app->name);
+        ushell_status = (*(app->function))(argc, argv, context);
+        // clear dummy keystroke handler
+        if (current_keystroke_handler == USHELL_KEYSTROKE_HANDLER_DUMMY)
+            current_keystroke_handler = handler;
+        invocation_end(context, handler);
+        return ushell_status;
     }
 
     // command not recognized
+    ushell_status = USHELL_STATUS_NOT_FOUND;
     log_error("Command not recognized");
-    writeln(command_line);
-    return;
+    writeln(argv[0]);
+    suggest_commands(argv[0], 0);
+    return ushell_status;
+}
+
+char* ushell_split_commands(char* s, ushell_sequence_t* next)
+{
+    char quote = 0;
+    for (; *s != '\0'; s++)
+    {
+        if (quote != 0)
+        {
+            if (*s == quote)
+                quote = 0;
+        }
+        else if (*s == '\'' || *s == '"')
+        {
+            quote = *s;
+        }
+        else if (*s == ';')
+        {
+            *next = USHELL_SEQUENCE_ALWAYS;
+            *s = '\0';
+            return s+1;
+        }
+        else if ((*s == '&' || *s == '|') && s[1] == *s)
+        {
+            *next = (*s == '&') ? USHELL_SEQUENCE_AND : USHELL_SEQUENCE_OR;
+            *s = '\0';
+            return s+2;
+        }
+    }
+    return 0;
+}
+
+bool ushell_sequence_due(ushell_sequence_t sequence, int status)
+{
+    if (sequence == USHELL_SEQUENCE_AND)
+        return status == USHELL_STATUS_SUCCESS;
+    if (sequence == USHELL_SEQUENCE_OR)
+        return status != USHELL_STATUS_SUCCESS;
+    return true;
+}
+
+int ushell_execute_line(char* line)
+{
+    keystroke_handler_t handler = current_keystroke_handler;
+    ushell_sequence_t sequence = USHELL_SEQUENCE_ALWAYS;
+
+    while (line != 0)
+    {
+        char* command = line;
+        ushell_sequence_t next;
+        line = ushell_split_commands(command, &next);
+
+        // skip commands chained by && or ||, as the previous status demands
+        if (ushell_sequence_due(sequence, ushell_status))
+        {
+            // split command into substrings,
+            // variables are substituted right before execution
+            char* cv[MAX_SUBSTRINGS];
+            char expansion[USHELL_VARIABLE_EXPANSION_SIZE];
+            uint8_t cc = ushell_tokenize(command, cv, MAX_SUBSTRINGS, expansion, sizeof(expansion));
+            if (cc > 0)
+                ushell_execute(cc, cv);
+
+            // stop, if an application remains running
+            if (current_keystroke_handler != handler)
+                break;
+        }
+        sequence = next;
+    }
+
+    return ushell_status;
+}
+
+/**
+ * @brief Output handler appending to the ushell_exec() buffer
+ */
+void exec_capture(uint8_t c)
+{
+    if (exec_length+1 >= exec_size)
+        return;
+    exec_output[exec_length++] = c;
+    exec_output[exec_length] = '\0';
+}
+
+int ushell_exec(const char* command, char* output, uint16_t size)
+{
+    if (strlen(command) >= MAX_LENGTH)
+    {
+        ushell_status = USHELL_STATUS_FAILURE;
+        return ushell_status;
+    }
+    char line[MAX_LENGTH];
+    strcpy(line, command);
+
+    // remember the state of an outer invocation
+    char* outer_output = exec_output;
+    uint16_t outer_size = exec_size;
+    uint16_t outer_length = exec_length;
+    output_handler_t outer_output_handler = current_output_handler;
+    keystroke_handler_t outer_keystroke_handler = current_keystroke_handler;
+
+    exec_output = output;
+    exec_size = (output != 0) ? size : 0;
+    exec_length = 0;
+    if (exec_size > 0)
+        output[0] = '\0';
+
+    // capture all output and keep log messages off the prompt
+    ushell_attach_output_handler(&exec_capture);
+    current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
+
+    int status = ushell_execute_line(line);
+
+    // an application attached itself, but can not be interacted with:
+    // stop it like the user would, otherwise release it
+    if (current_keystroke_handler != USHELL_KEYSTROKE_HANDLER_DUMMY
+     && current_keystroke_handler != 0)
+    {
+        if (ushell_receiving())
+            ushell_receive_abort();
+        else
+            (*current_keystroke_handler)(KEY_CTRL_C);
+        if (current_keystroke_handler != USHELL_KEYSTROKE_HANDLER_DUMMY)
+            ushell_release_keystroke_handler();
+
+        log_error("Applications can not remain running within ushell_exec()");
+        status = USHELL_STATUS_FAILURE;
+        ushell_status = status;
+    }
+
+    current_keystroke_handler = outer_keystroke_handler;
+    ushell_attach_output_handler(outer_output_handler);
+    exec_output = outer_output;
+    exec_size = outer_size;
+    exec_length = outer_length;
+
+    return status;
+}
+
+/**
+ * @brief Command input evaluator
+ * Run, whenever the user hits the ENTER key.
+ */
+void command_line_evaluator()
+{
+    // page the output of the whole command line
+    if (ushell_pager_pipe(command_line))
+        ushell_pager_start();
+
+    ushell_execute_line(command_line);
+    ushell_pager_finish();
 }
 
 
@@ -236,59 +911,98 @@ void command_line_evaluator()
  * to browse through it's command history
  */
 
-// static memory allocation
-char* history_entry[] =
-{
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-    "\0" "12345678901234567890123456789",
-};
-
-bool history_browser(uint32_t key)
-{
+/*
+ * Previously invoked commands are stored '\0'-terminated
+ * one after another, the most recent one last.
+ * The oldest commands are discarded, when the arena is full.
+ */
+char history_arena[USHELL_HISTORY_SIZE];
+uint16_t history_arena_used = 0;
 
-    // 0: current command line, 1-9: previously invoked commands
-    static uint8_t current_history_position = 0;
-    uint8_t previous_history_position = current_history_position;
+// number of commands browsed back, 0: the line being edited
+uint8_t history_position = 0;
 
-    if (key == KEY_UP && current_history_position < 9)
-        current_history_position++;
-    if (key == KEY_DOWN && current_history_position > 0)
-        current_history_position--;
+// line being edited, while browsing
+char history_edit[MAX_LENGTH];
 
-    if (current_history_position != previous_history_position)
+/**
+ * @brief Previously invoked command by age
+ * @param age: 1 for the most recent command
+ * @return Command or 0, if the history holds fewer commands
+ */
+char* history_entry(uint8_t age)
+{
+    uint16_t p = history_arena_used;
+    for (uint8_t i=0; i<age; i++)
     {
-        // save current command line to history position 0
-        strncpy(history_entry[previous_history_position], (char*) &command_line, length);
+        if (p == 0)
+            return 0;
+        // skip the terminator, then walk back to the beginning of the entry
+        p--;
+        while (p > 0 && history_arena[p-1] != '\0')
+            p--;
+    }
+    return &history_arena[p];
+}
 
-        // clear line
-        terminal_output_string(ANSI_CURSOR_LEFT(MAX_LENGTH) ANSI_CLEAR_LINE);
-        ushell_prompt();
-        command_line[0] = 0;
-        length = 0;
+/**
+ * @brief Append a command to the history
+ */
+void history_add(char* line)
+{
+    uint16_t l = strlen(line) + 1;
+    if (l == 1 || l > USHELL_HISTORY_SIZE)
+        return;
 
-        // print selected history position
-        uint8_t l = strlen(history_entry[current_history_position]);
-        strncpy((char*) &command_line, history_entry[current_history_position], l);
-        length = l;
-        terminal_output_string(history_entry[current_history_position]);
-    }
+    // do not repeat the most recent command
+    char* recent = history_entry(1);
+    if (recent != 0 && strcmp(recent, line) == 0)
+        return;
 
-    // add current command line to command history
-    if (key == KEY_ENTER)
+    // discard the oldest commands
+    while (history_arena_used + l > USHELL_HISTORY_SIZE)
     {
-        strncpy(history_entry[1], (char*) &command_line, length);
+        uint16_t n = strlen(history_arena) + 1;
+        memmove(history_arena, &history_arena[n], history_arena_used - n);
+        history_arena_used -= n;
     }
 
-    // whether key was handled or not
-    return key == KEY_UP || key == KEY_DOWN;
+    memcpy(&history_arena[history_arena_used], line, l);
+    history_arena_used += l;
+}
+
+/**
+ * @brief Browse through the command history using the arrow keys
+ * @return Whether the key was handled
+ */
+bool history_browser(uint32_t key)
+{
+    uint8_t position = history_position;
+    if (key == KEY_UP && history_entry(position+1) != 0)
+        position++;
+    else if (key == KEY_DOWN && position > 0)
+        position--;
+    else
+        return key == KEY_UP || key == KEY_DOWN;
+
+    // keep the line being edited
+    if (history_position == 0)
+        strcpy(history_edit, command_line);
+    history_position = position;
+
+    char* line = (position == 0) ? history_edit : history_entry(position);
+    strncpy(command_line, line, MAX_LENGTH-1);
+    command_line[MAX_LENGTH-1] = '\0';
+    length = strlen(command_line);
+    #ifdef USHELL_HIGHLIGHT
+    ushell_highlight_line(command_line);
+    #endif
+
+    // replace the line on the terminal
+    write("\r" ANSI_CLEAR_LINE);
+    ushell_prompt();
+    write_command_line();
+    return true;
 }
 
 /**
@@ -296,15 +1010,33 @@ bool history_browser(uint32_t key)
  */
 inline void autocomplete()
 {
+    // complete arguments once the command is complete
+    if (strchr(command_line, ' ') != 0)
+    {
+        uint8_t l = length;
+        if (ushell_complete_argument(command_line, MAX_LENGTH))
+        {
+            // redraw command line below the listed candidates
+            ushell_prompt();
+            write_command_line();
+        }
+        else
+        {
+            write(&command_line[l]);
+        }
+        length = strlen(command_line);
+        return;
+    }
+
     // whether the user input matched any known commands
     bool matches = false;
 
     char *string = "";
 
     // check user input against all known commands
-    for (uint8_t i=0; i<ushell_app_list->count; i++)
+    for (uint16_t i=0; i<BUILTIN_COUNT+ushell_app_count(); i++)
     {
-        ushell_app_t* app = &ushell_app_list->apps[i];
+        const ushell_app_t* app = (i < BUILTIN_COUNT) ? &ushell_builtins[i] : ushell_app(i-BUILTIN_COUNT);
 
         // null pointer? this shouldn't happen
         if (app->name == 0)
@@ -328,6 +1060,13 @@ inline void autocomplete()
         }
     }
 
+    // check user input against user-defined aliases
+    if (!matches)
+    {
+        string = ushell_alias_complete(command_line);
+        matches = (string != 0);
+    }
+
     if (matches)
     {
     	crlf();
@@ -336,8 +1075,11 @@ inline void autocomplete()
         // Setup the matched command
         strncpy(command_line, string+'\0', strlen(string)+1);
         length = strlen(string);
+        #ifdef USHELL_HIGHLIGHT
+        ushell_highlight_line(command_line);
+        #endif
         // Write the Command for the Prompt
-        write(command_line);
+        write_command_line();
     }
 }
 
@@ -392,6 +1134,30 @@ bool catch_special_char_state_machine(uint8_t regular, uint32_t* special)
  */
 void ushell_input_char(uint8_t c)
 {
+    // record session
+    ushell_record_input(c);
+
+    // binary transfer bypasses flow control, echo and line editing
+    if (ushell_receiving())
+    {
+        ushell_receive_input(c);
+        return;
+    }
+
+    #ifdef USHELL_FLOW_CONTROL_XONXOFF
+    // the terminal requests to pause or resume output
+    if (c == KEY_XOFF)
+    {
+        ushell_output_pause();
+        return;
+    }
+    if (c == KEY_XON)
+    {
+        ushell_output_resume();
+        return;
+    }
+    #endif
+
     static uint32_t b;
     if (catch_special_char_state_machine(c, &b))
         return;
@@ -400,6 +1166,9 @@ void ushell_input_char(uint8_t c)
     if (current_keystroke_handler == USHELL_KEYSTROKE_HANDLER_DUMMY)
         return;
 
+    // reprint prompt after log messages, before echoing the input
+    ushell_prompt_redraw();
+
     // a running application requested input forwarding
     if (current_keystroke_handler != 0)
     {
@@ -408,8 +1177,8 @@ void ushell_input_char(uint8_t c)
     }
 
     // allow browsing through command history
-//    if (history_browser(b))
-//        return;
+    if (history_browser(b))
+        return;
 
     if (b == KEY_BACKSPACE)
     {
@@ -418,10 +1187,17 @@ void ushell_input_char(uint8_t c)
             length--;
             command_line[length] = '\0';
             write(ANSI_CURSOR_LEFT(1) " " ANSI_CURSOR_LEFT(1));
+            #ifdef USHELL_HIGHLIGHT
+            ushell_highlight_erase(command_line, length);
+            #endif
         }
     }
     else if (b == KEY_ENTER)
     {
+        #ifdef USHELL_SCROLLBACK
+        ushell_scrollback_command(true);
+        #endif
+
         // line forward
         if (ushell_echo)
             crlf();
@@ -438,12 +1214,18 @@ void ushell_input_char(uint8_t c)
         crlf();
         #endif
 
-        // Just copy the last command for the KEY_UP feature
-        strncpy(last_command_line, command_line+'\0', strlen(command_line)+1);
+        // remember the command, before it is split into arguments
+        history_add(command_line);
+        history_position = 0;
 
         // evaluate user input
+        ushell_completion_reset();
         command_line_evaluator();
 
+        #ifdef USHELL_SCROLLBACK
+        ushell_scrollback_command(false);
+        #endif
+
         // only return to command prompt,
         // if application did not request keystroke forwarding
         // i.e. wishes to remain "running"
@@ -461,6 +1243,7 @@ void ushell_input_char(uint8_t c)
         // abort user input
         writeln("^C");
         clear_command_line();
+        history_position = 0;
 
         // return to input prompt
         ushell_prompt();
@@ -470,17 +1253,6 @@ void ushell_input_char(uint8_t c)
         // try to autocomplete the user's input
         autocomplete();
     }
-    else if (b == KEY_UP)
-    {
-        clear_command_line();
-        // Copy last command to command_line
-        strncpy(command_line, last_command_line+'\0', strlen(last_command_line)+1);
-        length = strlen(last_command_line);
-        // clear command line and Write the Command to the Prompt
-        crlf();
-        ushell_prompt();
-        write(command_line);
-    }
     else
     #ifndef USHELL_ACCEPT_NONPRINTABLE
     if (is_printable(b))
@@ -492,9 +1264,14 @@ void ushell_input_char(uint8_t c)
             command_line[length++] = b;
             command_line[length] = '\0';
 
+            #ifdef USHELL_HIGHLIGHT
+            // echo char back to terminal, colouring the command
+            ushell_highlight_append(command_line, length);
+            #else
             // echo char back to terminal
             if (ushell_echo)
                 writec(b);
+            #endif
         }
         else
         {
@@ -518,6 +1295,22 @@ void ushell_input_string(char* s)
     }
 }
 
+void ushell_input_queue(uint8_t c)
+{
+    if ((uint8_t) (input_queue_head - input_queue_tail) >= USHELL_INPUT_QUEUE_SIZE)
+    {
+        input_overruns++;
+        return;
+    }
+    input_queue[input_queue_head % USHELL_INPUT_QUEUE_SIZE] = c;
+    input_queue_head++;
+}
+
+uint32_t ushell_input_overruns()
+{
+    return input_overruns;
+}
+
 void ushell_attach_keystroke_handler(keystroke_handler_t h)
 {
     current_keystroke_handler = h;
@@ -525,6 +1318,16 @@ void ushell_attach_keystroke_handler(keystroke_handler_t h)
 
 void ushell_release_keystroke_handler()
 {
+    // the application is no longer running
+    ushell_scratch_end_running();
+
+    // within ushell_exec() there is no prompt to return to
+    if (current_output_handler == &exec_capture)
+    {
+        current_keystroke_handler = USHELL_KEYSTROKE_HANDLER_DUMMY;
+        return;
+    }
+
     if (current_keystroke_handler != 0)
     {
         current_keystroke_handler = 0;
@@ -21,6 +21,8 @@
 #include <ansi.h>
 
 #include "helper.h"
+#include "output.h"
+#include "scratch.h"
 
 // character constants
 #define KEY_ESC         0x1B
@@ -61,8 +63,8 @@
 #define KEY_DEL             KEY_ESCAPE('3','~')
 
 // output macros
-#define writec(c)   terminal_output_char(c);
-#define write(s)    terminal_output_string(s);
+#define writec(c)   ushell_output_char(c);
+#define write(s)    ushell_output_string(s);
 #define LINEBREAK   "\r\n"
 #define crlf()      write(LINEBREAK);
 #define writeln(s)  write(s); crlf();
@@ -76,7 +78,14 @@
 //#define USHELL_DEBUG_INPUT
 
 // application-like functions must have the following structure
-typedef void (*ushell_application_t)(uint8_t, char*[]);
+// and return an exit status;
+// the context is valid until the application returns or stops running
+typedef int (*ushell_application_t)(uint8_t, char*[], ushell_context_t*);
+
+// exit status conventions
+#define USHELL_STATUS_SUCCESS       0
+#define USHELL_STATUS_FAILURE       1
+#define USHELL_STATUS_NOT_FOUND     127
 
 // maximum length of the command line
 #define MAX_LENGTH 64
@@ -84,17 +93,56 @@ typedef void (*ushell_application_t)(uint8_t, char*[]);
 // maximum number of space-separated substrings in command line
 #define MAX_SUBSTRINGS 6
 
+// number of bytes available for the command history
+#define USHELL_HISTORY_SIZE 256
+
 // maximum number of registered applications (i.e. functions)
 #define MAX_APPS 16
 
+// commands within this edit distance are suggested for unrecognized input
+#define USHELL_SUGGEST_DISTANCE     2
+
+// maximum number of suggested commands
+#define USHELL_SUGGESTIONS          3
+
+// milliseconds between two invocations of ushell_tick()
+#define USHELL_TICK_MS 1
+
+// returned by ushell_next_deadline(), if no timer is pending
+#define USHELL_NO_DEADLINE  0xFFFFFFFF
+
+// number of received bytes, which can be queued by ushell_input_queue()
+// (must be a power of two)
+#define USHELL_INPUT_QUEUE_SIZE 32
+
+// optional argument completion callbacks must have the following structure:
+// return the index-th candidate for argument argv[argc],
+// given the preceding arguments, or 0, if there are no more candidates;
+// candidates must remain valid after returning (e.g. string constants)
+typedef const char* (*ushell_completion_t)(uint8_t argc, char* argv[], uint16_t index);
+
+typedef struct ushell_app ushell_app_t;
+
+// subcommands of a command group, sorted by name
+typedef struct
+{
+    uint16_t count;
+    const ushell_app_t* apps;
+} ushell_group_t;
+
 // setup structure to connect commands to functions
 // plus help texts
-typedef struct
+struct ushell_app
 {
     char* name;
     ushell_application_t function;
     char* help_brief;
-} ushell_app_t;
+    ushell_completion_t complete;
+
+    // subcommands, if this is a command group;
+    // the function (if any) is invoked, when no subcommand matches
+    const ushell_group_t* children;
+};
 
 typedef struct
 {
@@ -102,6 +150,73 @@ typedef struct
     ushell_app_t apps[];
 } ushell_app_list_t;
 
+// in C++ a const object would otherwise have internal linkage,
+// hiding duplicate names from the linker
+#ifdef __cplusplus
+#define USHELL_COMMAND_LINKAGE  extern "C" const
+#else
+#define USHELL_COMMAND_LINKAGE  const
+#endif
+
+/**
+ * @brief Register an application at its definition site
+ *
+ * Example:
+ *   USHELL_COMMAND(hello, &hello_world, "Say hello")
+ *
+ * The descriptor is placed in a linker section of its own.
+ * Linking with ushell_commands.ld collects all such sections
+ * into one table sorted by command name, so that no initialization
+ * is required at runtime and commands can be found by binary search.
+ * Registering the same name twice fails to link,
+ * also across C and C++ translation units.
+ */
+#define USHELL_COMMAND(name, fn, help) \
+    USHELL_COMMAND_COMPLETE(name, fn, help, 0)
+
+/**
+ * @brief Register an application with an argument completion callback
+ */
+#define USHELL_COMMAND_COMPLETE(name, fn, help, complete) \
+    USHELL_COMMAND_LINKAGE ushell_app_t ushell_command_##name \
+        __attribute__((section(".ushell_command." #name), used, aligned(sizeof(void*)))) = \
+        { (char*) #name, fn, (char*) (help), complete };
+
+/**
+ * @brief Subcommand table of a command group
+ *
+ * The table must be sorted by name, so that subcommands
+ * can be found by binary search. Entries may be groups themselves.
+ * This macro uses a compound literal and is therefore C only.
+ */
+#define USHELL_GROUP(table) \
+    (&(const ushell_group_t) { sizeof(table)/sizeof((table)[0]), table })
+
+/**
+ * @brief Register a command group, e.g. "gpio set" and "gpio get"
+ *
+ * Example:
+ *   const ushell_app_t gpio_commands[] =
+ *   {
+ *       { "get",    &gpio_get,    "Read a pin: gpio get <pin>" },
+ *       { "set",    &gpio_set,    "Write a pin: gpio set <pin> <value>" },
+ *       { "toggle", &gpio_toggle, "Toggle a pin: gpio toggle <pin>" },
+ *   };
+ *   USHELL_COMMAND_GROUP(gpio, gpio_commands, "GPIO access")
+ *
+ * Invoked without subcommand, the group's help is shown.
+ */
+#define USHELL_COMMAND_GROUP(name, table, help) \
+    static const ushell_group_t ushell_group_##name = \
+        { sizeof(table)/sizeof((table)[0]), table }; \
+    USHELL_COMMAND_LINKAGE ushell_app_t ushell_command_##name \
+        __attribute__((section(".ushell_command." #name), used, aligned(sizeof(void*)))) = \
+        { (char*) #name, 0, (char*) (help), 0, &ushell_group_##name };
+
+// boundaries of the command registry, provided by ushell_commands.ld
+extern const ushell_app_t __start_ushell_commands[] __attribute__((weak));
+extern const ushell_app_t __stop_ushell_commands[] __attribute__((weak));
+
 
 /**
  * @brief Clear terminal screen
@@ -124,6 +239,18 @@ extern void terminal_output_char(uint8_t);
 extern void terminal_output_string(char*);
 
 
+/**
+ * @brief Output a character via the currently attached output handler
+ * or the transmit buffer, if no output handler is attached
+ */
+void ushell_output_char(uint8_t);
+
+/**
+ * @brief Output a null-terminated string
+ * via the currently attached output handler or the transmit buffer
+ */
+void ushell_output_string(char*);
+
 /**
  * @brief Event handler for user input (e.g. keystrokes via UART)
  * @param b: Received byte
@@ -136,6 +263,19 @@ void ushell_input_char(uint8_t);
  */
 void ushell_input_string(char*);
 
+/**
+ * @brief Queue a received byte for processing by ushell_poll()
+ *
+ * Safe to invoke from interrupt context, as opposed to ushell_input_char().
+ * Bytes are discarded, if the queue is full.
+ */
+void ushell_input_queue(uint8_t);
+
+/**
+ * @brief Number of received bytes discarded, because the input queue was full
+ */
+uint32_t ushell_input_overruns();
+
 /*
  * Turn microshell echo on/off
  */
@@ -147,11 +287,24 @@ void ushell_echo_off();
  */
 void ushell_help();
 
+/**
+ * @brief Output one row of the help table
+ */
+void ushell_help_row(char* name, char* text);
+
 /**
  * @brief Output user input prompt
  */
 void ushell_prompt();
 
+/**
+ * @brief Reprint prompt and command line, if log messages overwrote them
+ *
+ * Invoked by ushell_poll() and upon user input,
+ * so that a burst of log messages causes only one redraw.
+ */
+void ushell_prompt_redraw();
+
 /**
  * Some invalid pointer address to assign to the
  * keystroke handler, so that it is recognized,
@@ -172,6 +325,177 @@ void ushell_prompt_suspend();
 void ushell_prompt_resume();
 
 
+/**
+ * @brief Advance the shell's time base by USHELL_TICK_MS
+ *
+ * Invoke periodically, e.g. from a SysTick or timer interrupt.
+ */
+void ushell_tick();
+
+/**
+ * @brief Advance the shell's time base by an arbitrary number of milliseconds
+ *
+ * Alternative to ushell_tick() for tickless operation,
+ * e.g. after waking up from low-power sleep.
+ */
+void ushell_advance(uint32_t milliseconds);
+
+/**
+ * @brief Milliseconds elapsed since the shell was initialized
+ */
+uint32_t ushell_uptime_ms();
+
+/**
+ * @brief Run pending periodic work, e.g. a command being watched
+ *
+ * Must be invoked from the main loop (not from interrupt context),
+ * since applications may be executed from within.
+ *
+ * @return Whether work remains pending, i.e. ushell_poll()
+ *         should be invoked again without sleeping
+ */
+bool ushell_poll();
+
+/**
+ * @brief Whether there is queued input, transmittable output,
+ *        completed telemetry frames or a prompt to redraw
+ *
+ * Output stalled by XOFF or terminal_output_ready() is not pending;
+ * the main loop must wake up on the interrupt, which resumes it.
+ */
+bool ushell_pending();
+
+/**
+ * @brief Uptime, at which ushell_poll() needs to be invoked next
+ *
+ * The current uptime (or earlier), if work is pending,
+ * USHELL_NO_DEADLINE if nothing but input can cause work.
+ * In between, the main loop may sleep until the deadline
+ * or until the next receive interrupt, whichever comes first:
+ *
+ *   while (1)
+ *   {
+ *       if (ushell_poll())
+ *           continue;
+ *       disable_interrupts();
+ *       if (!ushell_pending())
+ *           sleep_until(ushell_next_deadline());  // e.g. wake-up timer and WFI
+ *       enable_interrupts();
+ *   }
+ */
+uint32_t ushell_next_deadline();
+
+/**
+ * @brief Number of applications in the command list and registry
+ */
+uint16_t ushell_app_count();
+
+/**
+ * @brief Application by index, command list entries first
+ */
+ushell_app_t* ushell_app(uint16_t i);
+
+/**
+ * @brief Find the registered application with the given name
+ * @return Pointer to the application or 0, if no such application exists
+ */
+ushell_app_t* ushell_find_app(char* name);
+
+/**
+ * @brief Find the subcommand with the given name within a command group
+ * @return Pointer to the subcommand or 0, if there is none
+ */
+ushell_app_t* ushell_find_child(const ushell_group_t* group, char* name);
+
+/**
+ * @brief Descend from a command into its groups,
+ *        as far as the following arguments name subcommands
+ *
+ * @param app: Command named by argv[0], receives the deepest subcommand found
+ * @return Number of arguments consumed, i.e. the subcommand is named by argv[return value]
+ */
+uint8_t ushell_find_subcommand(ushell_app_t** app, uint8_t argc, char* argv[]);
+
+
+/**
+ * @brief Split a string in-place into space-separated substrings
+ *
+ * Single or double quotes group substrings containing spaces.
+ * Variable references are substituted except within single quotes;
+ * affected substrings are placed in the expansion buffer,
+ * all others remain in-place.
+ *
+ * @param expansion: Buffer for substrings containing variables,
+ *                   0 to disable substitution
+ * @param size: Size of the expansion buffer
+ * @return Number of substrings
+ */
+uint8_t ushell_tokenize(char* s, char* argv[], uint8_t max, char* expansion, uint16_t size);
+
+/**
+ * @brief Exit status of the most recently executed command
+ *
+ * As returned by the application, 127 if it was not recognized.
+ */
+int ushell_last_status();
+
+/**
+ * @brief Execute a built-in command, alias or application
+ * @return Exit status
+ */
+int ushell_execute(uint8_t argc, char* argv[]);
+
+// how a command is chained to its predecessor
+typedef enum
+{
+    USHELL_SEQUENCE_ALWAYS,     // ;
+    USHELL_SEQUENCE_AND,        // &&
+    USHELL_SEQUENCE_OR,         // ||
+} ushell_sequence_t;
+
+/**
+ * @brief Terminate the first command in a string in-place
+ *
+ * Separators within quotes are ignored.
+ *
+ * @param next: Receives how the following command is chained
+ * @return Beginning of the following command or 0, if there is none
+ */
+char* ushell_split_commands(char* s, ushell_sequence_t* next);
+
+/**
+ * @brief Whether a chained command is executed,
+ *        given the exit status of its predecessor
+ */
+bool ushell_sequence_due(ushell_sequence_t sequence, int status);
+
+/**
+ * @brief Execute a command line, which may consist of
+ *        several commands separated by ;, && or ||
+ *
+ * The string is modified in-place.
+ *
+ * @return Exit status of the last executed command
+ */
+int ushell_execute_line(char* line);
+
+/**
+ * @brief Execute a command line from code
+ *
+ * Commands are dispatched directly: There is no echo, no prompt
+ * and log messages do not touch the terminal.
+ * All output is captured into the given buffer, null-terminated
+ * and truncated if necessary. Invocations may be nested.
+ * Applications, which would remain running (e.g. watch),
+ * are stopped as if by Ctrl-C and fail with an error.
+ *
+ * @param output: Buffer for the captured output, 0 to discard it
+ * @param size: Size of the output buffer
+ * @return Exit status of the last executed command
+ */
+int ushell_exec(const char* command, char* output, uint16_t size);
+
+
 // referenced here, since it appears to be necessary for the function to be usable in ushell.c
 void autocomplete();
 
@@ -187,4 +511,13 @@ typedef void (*keystroke_handler_t)(uint32_t);
 void ushell_attach_keystroke_handler(keystroke_handler_t);
 void ushell_release_keystroke_handler();
 
+/*
+ * Output handlers allow to temporarily redirect
+ * all shell output (write, writec, syslog etc.),
+ * e.g. in order to capture an application's output.
+ */
+typedef void (*output_handler_t)(uint8_t);
+void ushell_attach_output_handler(output_handler_t);
+void ushell_release_output_handler();
+
 #endif // USHELL_H
@@ -0,0 +1,342 @@
+/**
+ * Shell variables
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "variable.h"
+#include "ushell.h"
+#include "syslog.h"
+
+
+extern int ushell_status;
+
+/*
+ * Each variable is stored as one entry in the arena:
+ *
+ *   [entry length] [live] [name] '\0' [value] '\0'
+ *
+ * Unset or overwritten entries remain in the arena (live = 0),
+ * until the arena is compacted.
+ */
+uint8_t variable_arena[USHELL_VARIABLE_ARENA_SIZE];
+uint16_t variable_arena_used = 0;
+
+// arena offset + 1 of the entry occupying a slot
+uint16_t variable_slot[USHELL_VARIABLE_SLOTS];
+#define SLOT_EMPTY      0
+#define SLOT_DELETED    0xFFFF
+
+#define variable_name(entry)    ((char*) &(entry)[2])
+#define variable_value(entry)   (variable_name(entry) + strlen(variable_name(entry)) + 1)
+
+// receives the values of built-in variables
+char variable_builtin_value[11];
+
+
+/**
+ * @brief FNV-1a hash of a variable name
+ */
+uint32_t variable_hash(char* name, uint8_t length)
+{
+    uint32_t h = 2166136261u;
+    for (uint8_t i=0; i<length; i++)
+    {
+        h ^= (uint8_t) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Find the slot of a variable
+ * @return Slot index or -1, if the variable does not exist
+ */
+int8_t variable_find(char* name, uint8_t length)
+{
+    uint8_t i = variable_hash(name, length) & (USHELL_VARIABLE_SLOTS-1);
+    for (uint8_t probe=0; probe<USHELL_VARIABLE_SLOTS; probe++)
+    {
+        uint16_t s = variable_slot[i];
+        if (s == SLOT_EMPTY)
+            return -1;
+
+        if (s != SLOT_DELETED)
+        {
+            char* n = variable_name(&variable_arena[s-1]);
+            if (strncmp(n, name, length) == 0 && n[length] == '\0')
+                return i;
+        }
+        i = (i+1) & (USHELL_VARIABLE_SLOTS-1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Remove entries of unset variables from the arena
+ */
+void variable_compact()
+{
+    uint16_t r = 0;
+    uint16_t w = 0;
+    while (r < variable_arena_used)
+    {
+        uint8_t l = variable_arena[r];
+        if (variable_arena[r+1])
+        {
+            if (r != w)
+            {
+                // the slot referring to the entry must follow it
+                char* name = variable_name(&variable_arena[r]);
+                int8_t i = variable_find(name, strlen(name));
+                variable_slot[i] = w+1;
+                memmove(&variable_arena[w], &variable_arena[r], l);
+            }
+            w += l;
+        }
+        r += l;
+    }
+    variable_arena_used = w;
+}
+
+bool ushell_variable_unset(char* name)
+{
+    int8_t i = variable_find(name, strlen(name));
+    if (i < 0)
+        return false;
+
+    // mark entry as no longer live
+    variable_arena[variable_slot[i]-1 + 1] = 0;
+    variable_slot[i] = SLOT_DELETED;
+    return true;
+}
+
+bool ushell_variable_set(char* name, char* value)
+{
+    uint8_t name_length = strlen(name);
+    uint16_t l = 2 + name_length + 1 + strlen(value) + 1;
+    if (l > 255)
+        return false;
+
+    // the entry being replaced is unset only, once the new one fits
+    int8_t existing = variable_find(name, name_length);
+    uint8_t freed = (existing < 0) ? 0 : variable_arena[variable_slot[existing]-1];
+    if (variable_arena_used + l > USHELL_VARIABLE_ARENA_SIZE)
+        variable_compact();
+    if (variable_arena_used - freed + l > USHELL_VARIABLE_ARENA_SIZE)
+        return false;
+
+    ushell_variable_unset(name);
+    if (variable_arena_used + l > USHELL_VARIABLE_ARENA_SIZE)
+        variable_compact();
+
+    // occupy the first free slot
+    uint8_t i = variable_hash(name, name_length) & (USHELL_VARIABLE_SLOTS-1);
+    uint8_t probe;
+    for (probe=0; probe<USHELL_VARIABLE_SLOTS; probe++)
+    {
+        if (variable_slot[i] == SLOT_EMPTY || variable_slot[i] == SLOT_DELETED)
+            break;
+        i = (i+1) & (USHELL_VARIABLE_SLOTS-1);
+    }
+    if (probe >= USHELL_VARIABLE_SLOTS)
+        return false;
+
+    uint8_t* entry = &variable_arena[variable_arena_used];
+    entry[0] = l;
+    entry[1] = 1;
+    strcpy(variable_name(entry), name);
+    strcpy(variable_value(entry), value);
+    variable_slot[i] = variable_arena_used + 1;
+    variable_arena_used += l;
+    return true;
+}
+
+/**
+ * @brief Look up a variable by a name, which is not null-terminated
+ */
+char* variable_lookup(char* name, uint8_t length)
+{
+    // built-in variables
+    if (length == 1 && name[0] == '?')
+    {
+        int2str(ushell_last_status(), variable_builtin_value);
+        return variable_builtin_value;
+    }
+    if (length == 6 && strncmp(name, "UPTIME", 6) == 0)
+    {
+        uint2str(ushell_uptime_ms() / 1000, variable_builtin_value);
+        return variable_builtin_value;
+    }
+    if (length == 9 && strncmp(name, "UPTIME_MS", 9) == 0)
+    {
+        uint2str(ushell_uptime_ms(), variable_builtin_value);
+        return variable_builtin_value;
+    }
+
+    int8_t i = variable_find(name, length);
+    if (i < 0)
+        return 0;
+    return variable_value(&variable_arena[variable_slot[i]-1]);
+}
+
+char* ushell_variable_get(char* name)
+{
+    return variable_lookup(name, strlen(name));
+}
+
+/**
+ * @brief Whether a character may be part of a variable name
+ */
+bool variable_name_char(char c, bool first)
+{
+    return (c >= 'A' && c <= 'Z')
+        || (c >= 'a' && c <= 'z')
+        || c == '_'
+        || (!first && c >= '0' && c <= '9');
+}
+
+char* ushell_variable_reference(char* s, char** value)
+{
+    char* name = s+1;
+    char* end;
+
+    if (*name == '?')
+    {
+        end = name+1;
+    }
+    else if (*name == '{')
+    {
+        name++;
+        end = name;
+        while (variable_name_char(*end, end == name))
+            end++;
+        if (*end != '}' || end == name)
+            return s;
+    }
+    else
+    {
+        end = name;
+        while (variable_name_char(*end, end == name))
+            end++;
+        if (end == name)
+            return s;
+    }
+
+    *value = variable_lookup(name, end - name);
+    if (*value == 0)
+        *value = "";
+
+    return (*end == '}') ? end+1 : end;
+}
+
+void ushell_variable_expand(char* s, char* buffer, uint16_t size)
+{
+    uint16_t l = 0;
+    while (*s != '\0' && l < size-1)
+    {
+        char* value;
+        char* next;
+        if (*s == '$' && (next = ushell_variable_reference(s, &value)) != s)
+        {
+            while (*value != '\0' && l < size-1)
+                buffer[l++] = *value++;
+            s = next;
+            continue;
+        }
+        buffer[l++] = *s++;
+    }
+    buffer[l] = '\0';
+}
+
+/**
+ * @brief Whether a string is a valid variable name
+ */
+bool variable_name_valid(char* name, uint8_t length)
+{
+    if (length == 0)
+        return false;
+
+    for (uint8_t i=0; i<length; i++)
+        if (!variable_name_char(name[i], i == 0))
+            return false;
+
+    return true;
+}
+
+bool ushell_variable_assignment(uint8_t argc, char* argv[])
+{
+    char* equals = strchr(argv[0], '=');
+    if (equals == 0 || !variable_name_valid(argv[0], equals - argv[0]))
+        return false;
+
+    ushell_status = USHELL_STATUS_FAILURE;
+    if (argc > 1)
+    {
+        log_error("Usage: NAME=value");
+        return true;
+    }
+
+    *equals = '\0';
+    if (!ushell_variable_set(argv[0], equals+1))
+    {
+        log_error("Not enough memory to store variable");
+        return true;
+    }
+    ushell_status = USHELL_STATUS_SUCCESS;
+    return true;
+}
+
+int ushell_set(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    // list all variables
+    if (argc == 1)
+    {
+        for (uint16_t offset=0; offset<variable_arena_used; offset+=variable_arena[offset])
+        {
+            uint8_t* entry = &variable_arena[offset];
+            if (!entry[1])
+                continue;
+            write(variable_name(entry));
+            writec('=');
+            writeln(variable_value(entry));
+        }
+        return USHELL_STATUS_SUCCESS;
+    }
+
+    // set NAME=value
+    if (argc == 2 && ushell_variable_assignment(1, &argv[1]))
+        return ushell_last_status();
+
+    // set NAME value
+    if (argc == 3 && variable_name_valid(argv[1], strlen(argv[1])))
+    {
+        if (!ushell_variable_set(argv[1], argv[2]))
+        {
+            log_error("Not enough memory to store variable");
+            return USHELL_STATUS_FAILURE;
+        }
+        return USHELL_STATUS_SUCCESS;
+    }
+
+    log_error("Usage: set [name[=value]]");
+    return USHELL_STATUS_FAILURE;
+}
+
+int ushell_unset(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    if (argc != 2)
+    {
+        log_error("Usage: unset <name>");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    if (!ushell_variable_unset(argv[1]))
+    {
+        log_error("Variable not found");
+        return USHELL_STATUS_FAILURE;
+    }
+    return USHELL_STATUS_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/**
+ * Shell variables
+ * ---------------------------------------------
+ *
+ * Variables are stored in an open-addressing hash map
+ * referring to entries in a fixed-size arena.
+ * $NAME and ${NAME} are substituted while tokenizing the command line.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_VARIABLE_H
+#define USHELL_VARIABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scratch.h"
+
+// number of hash map slots, must be a power of two
+#define USHELL_VARIABLE_SLOTS           16
+
+// number of bytes available for storing all variables
+#define USHELL_VARIABLE_ARENA_SIZE      256
+
+// size of the buffer receiving substrings with substituted variables
+#define USHELL_VARIABLE_EXPANSION_SIZE  128
+
+/**
+ * @brief Set a variable, replacing any previous value
+ * @return false, if there is not enough memory
+ */
+bool ushell_variable_set(char* name, char* value);
+
+/**
+ * @brief Get the value of a variable, including built-in variables
+ * @return The value or 0, if the variable is not defined
+ */
+char* ushell_variable_get(char* name);
+
+/**
+ * @brief Remove a variable
+ * @return false, if no such variable exists
+ */
+bool ushell_variable_unset(char* name);
+
+/**
+ * @brief Parse a variable reference ($NAME, ${NAME} or $?)
+ *
+ * @param s: Pointer to the '$'
+ * @param value: Receives the variable's value ("" if undefined)
+ * @return Pointer to the first character after the reference
+ *         or s, if it does not point to a valid reference
+ */
+char* ushell_variable_reference(char* s, char** value);
+
+/**
+ * @brief Copy a string to a buffer substituting all variable references
+ */
+void ushell_variable_expand(char* s, char* buffer, uint16_t size);
+
+/**
+ * @brief Handle a NAME=value command
+ * @return false, if argv[0] is not an assignment
+ */
+bool ushell_variable_assignment(uint8_t argc, char* argv[]);
+
+/**
+ * @brief Built-in command: set [name[=value]]
+ */
+int ushell_set(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Built-in command: unset <name>
+ */
+int ushell_unset(uint8_t argc, char* argv[], ushell_context_t* context);
+
+#endif // USHELL_VARIABLE_H
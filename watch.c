@@ -0,0 +1,363 @@
+/**
+ * Built-in watch command
+ * ---------------------------------------------
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#include "watch.h"
+#include "ushell.h"
+#include "syslog.h"
+#include "scratch.h"
+
+
+extern keystroke_handler_t current_keystroke_handler;
+extern output_handler_t current_output_handler;
+
+// shadow copy of the watched command's output as currently displayed
+char watch_screen[USHELL_WATCH_ROWS][USHELL_WATCH_COLUMNS];
+
+// one bit per cell, set if the cell changed during the current frame
+uint8_t watch_dirty[(USHELL_WATCH_ROWS*USHELL_WATCH_COLUMNS+7)/8];
+
+// number of columns written per row during the current frame
+uint8_t watch_row_length[USHELL_WATCH_ROWS];
+
+// number of rows containing output
+uint8_t watch_rows_used = 0;
+
+// position at which captured characters are placed
+uint16_t watch_capture_row;
+uint8_t watch_capture_column;
+
+// 0: regular text, 1: after ESC, 2: inside CSI sequence, 3: charset selection
+uint8_t watch_escape_state;
+
+// position of the terminal's cursor relative to the shadow screen
+uint8_t watch_cursor_row;
+uint8_t watch_cursor_column;
+bool watch_cursor_known = false;
+
+// the watched command
+bool watch_running = false;
+ushell_app_t* watch_app;
+uint8_t watch_argc;
+char watch_arguments[MAX_LENGTH];
+uint32_t watch_period;
+uint32_t watch_next_run;
+
+#define watch_is_dirty(r, c)    (watch_dirty[((r)*USHELL_WATCH_COLUMNS+(c)) >> 3] & (1 << (((r)*USHELL_WATCH_COLUMNS+(c)) & 7)))
+#define watch_set_dirty(r, c)   watch_dirty[((r)*USHELL_WATCH_COLUMNS+(c)) >> 3] |= (1 << (((r)*USHELL_WATCH_COLUMNS+(c)) & 7));
+
+
+/**
+ * @brief Place a character at the capture position of the shadow screen
+ */
+void watch_put(char c)
+{
+    uint16_t r = watch_capture_row;
+    uint8_t col = watch_capture_column;
+
+    // clip output exceeding the shadow screen
+    if (r >= USHELL_WATCH_ROWS || col >= USHELL_WATCH_COLUMNS)
+        return;
+
+    if (watch_screen[r][col] != c)
+    {
+        watch_screen[r][col] = c;
+        watch_set_dirty(r, col);
+    }
+
+    watch_capture_column++;
+    if (watch_capture_column > watch_row_length[r])
+        watch_row_length[r] = watch_capture_column;
+}
+
+/**
+ * @brief Output handler capturing the watched command's output
+ *
+ * ANSI escape sequences are stripped, since the shadow screen stores characters only.
+ */
+void watch_capture(uint8_t c)
+{
+    switch (watch_escape_state)
+    {
+        case 1:
+            if (c == '[')
+                watch_escape_state = 2;
+            else if (c == '(' || c == ')')
+                watch_escape_state = 3;
+            else
+                watch_escape_state = 0;
+            return;
+
+        case 2:
+            // final byte of a control sequence
+            if (c >= 0x40 && c <= 0x7E)
+                watch_escape_state = 0;
+            return;
+
+        case 3:
+            watch_escape_state = 0;
+            return;
+    }
+
+    if (c == KEY_ESC)
+    {
+        watch_escape_state = 1;
+    }
+    else if (c == '\r')
+    {
+        watch_capture_column = 0;
+    }
+    else if (c == '\n')
+    {
+        // rows below the shadow screen remain clipped
+        if (watch_capture_row < USHELL_WATCH_ROWS)
+            watch_capture_row++;
+        watch_capture_column = 0;
+    }
+    else if (c == '\t')
+    {
+        do
+        {
+            watch_put(' ');
+        }
+        while ((watch_capture_column & 7) != 0 && watch_capture_column < USHELL_WATCH_COLUMNS);
+    }
+    else if (is_printable(c))
+    {
+        watch_put(c);
+    }
+}
+
+/**
+ * @brief Move the terminal cursor to a cell of the shadow screen
+ */
+void watch_cursor_to(uint8_t row, uint8_t column)
+{
+    if (watch_cursor_known
+     && watch_cursor_row == row
+     && watch_cursor_column == column)
+        return;
+
+    char buffer[11];
+    write(ANSI_ESC "[");
+    uint2str(row + USHELL_WATCH_FIRST_ROW, buffer);
+    write(buffer);
+    writec(';');
+    uint2str(column + 1, buffer);
+    write(buffer);
+    writec('H');
+
+    watch_cursor_row = row;
+    watch_cursor_column = column;
+    watch_cursor_known = true;
+}
+
+/**
+ * @brief Transmit all cells, which changed during the current frame
+ */
+void watch_flush()
+{
+    char run[USHELL_WATCH_COLUMNS+1];
+
+    for (uint8_t r=0; r<USHELL_WATCH_ROWS; r++)
+    {
+        uint8_t c = 0;
+        while (c < USHELL_WATCH_COLUMNS)
+        {
+            if (!watch_is_dirty(r, c))
+            {
+                c++;
+                continue;
+            }
+
+            // extend the run across short gaps of unchanged cells
+            uint8_t start = c;
+            uint8_t end = c+1;
+            for (c=c+1; c<USHELL_WATCH_COLUMNS && c-end < USHELL_WATCH_MAX_GAP; c++)
+            {
+                if (watch_is_dirty(r, c))
+                    end = c+1;
+            }
+
+            uint8_t n = end - start;
+            memcpy(run, &watch_screen[r][start], n);
+            run[n] = '\0';
+
+            watch_cursor_to(r, start);
+            write(run);
+            watch_cursor_column += n;
+            c = end;
+        }
+    }
+
+    memset(watch_dirty, 0, sizeof(watch_dirty));
+}
+
+/**
+ * @brief Execute the watched command once and update the screen
+ */
+void watch_run()
+{
+    // rebuild the argument vector, as the application may modify it
+    char arguments[MAX_LENGTH];
+    char* argv[MAX_SUBSTRINGS];
+    memcpy(arguments, watch_arguments, MAX_LENGTH);
+    char* p = arguments;
+    for (uint8_t i=0; i<watch_argc; i++)
+    {
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    // begin new frame
+    watch_capture_row = 0;
+    watch_capture_column = 0;
+    watch_escape_state = 0;
+    memset(watch_row_length, 0, sizeof(watch_row_length));
+
+    // capture output into the shadow screen,
+    // an outer handler (e.g. of ushell_exec()) receives the screen updates
+    keystroke_handler_t handler = current_keystroke_handler;
+    output_handler_t output_handler = current_output_handler;
+    ushell_attach_output_handler(&watch_capture);
+    ushell_context_t* context = ushell_scratch_begin(watch_app->name);
+    (*(watch_app->function))(watch_argc, argv, context);
+    ushell_scratch_end(context);
+    ushell_attach_output_handler(output_handler);
+    current_keystroke_handler = handler;
+
+    // blank cells, which were not written during this frame
+    watch_rows_used = 0;
+    for (uint8_t r=0; r<USHELL_WATCH_ROWS; r++)
+    {
+        if (watch_row_length[r] > 0)
+            watch_rows_used = r+1;
+
+        for (uint8_t c=watch_row_length[r]; c<USHELL_WATCH_COLUMNS; c++)
+        {
+            if (watch_screen[r][c] != ' ')
+            {
+                watch_screen[r][c] = ' ';
+                watch_set_dirty(r, c);
+            }
+        }
+    }
+
+    watch_flush();
+}
+
+/**
+ * @brief Returns to the prompt, when the user presses Ctrl-C
+ */
+void watch_keystroke_handler(uint32_t key)
+{
+    if (key == KEY_CTRL_C)
+        ushell_watch_stop();
+}
+
+int ushell_watch(uint8_t argc, char* argv[], ushell_context_t* context)
+{
+    uint8_t first = 1;
+    uint32_t period = USHELL_WATCH_DEFAULT_PERIOD_MS;
+
+    if (argc >= 3 && strcmp(argv[1], "-n") == 0)
+    {
+        if (!str2duration(argv[2], &period) || period == 0)
+        {
+            log_error("Invalid period");
+            return USHELL_STATUS_FAILURE;
+        }
+        first = 3;
+    }
+
+    if (first >= argc)
+    {
+        log_error("Usage: watch [-n <period>] <command> [arguments]");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    // the subcommand of a command group is executed with its arguments
+    uint8_t command = first;
+    ushell_app_t* app = ushell_find_app(argv[first]);
+    if (app != 0)
+        command += ushell_find_subcommand(&app, argc-first, &argv[first]);
+    if (app == 0 || app->function == 0)
+    {
+        log_error("Command not recognized");
+        return USHELL_STATUS_FAILURE;
+    }
+
+    // keep a copy of the arguments, since the command line is reused
+    uint8_t offset = 0;
+    for (uint8_t i=command; i<argc; i++)
+    {
+        uint8_t l = strlen(argv[i]) + 1;
+        memcpy(&watch_arguments[offset], argv[i], l);
+        offset += l;
+    }
+    watch_argc = argc - command;
+    watch_app = app;
+    watch_period = period;
+
+    // begin with a blank screen and header
+    memset(watch_screen, ' ', sizeof(watch_screen));
+    memset(watch_dirty, 0, sizeof(watch_dirty));
+    watch_cursor_known = false;
+    write(ANSI_RESET ANSI_CLEAR_SCREEN ANSI_CURSOR_TO(1,1) ANSI_HIDE_CURSOR "Every ");
+    char buffer[11];
+    uint2str(period, buffer);
+    write(buffer);
+    write("ms:");
+    for (uint8_t i=first; i<argc; i++)
+    {
+        writec(' ');
+        write(argv[i]);
+    }
+
+    ushell_attach_keystroke_handler(&watch_keystroke_handler);
+    watch_running = true;
+    watch_run();
+    watch_next_run = ushell_uptime_ms() + period;
+    return USHELL_STATUS_SUCCESS;
+}
+
+void ushell_watch_poll()
+{
+    if (!watch_running)
+        return;
+
+    uint32_t now = ushell_uptime_ms();
+    if ((int32_t) (now - watch_next_run) < 0)
+        return;
+
+    // keep the schedule, unless we fell behind by more than one period
+    watch_next_run += watch_period;
+    if ((int32_t) (now - watch_next_run) >= 0)
+        watch_next_run = now + watch_period;
+
+    watch_run();
+}
+
+uint32_t ushell_watch_deadline()
+{
+    if (!watch_running)
+        return USHELL_NO_DEADLINE;
+    return watch_next_run;
+}
+
+void ushell_watch_stop()
+{
+    if (!watch_running)
+        return;
+    watch_running = false;
+
+    // continue below the watched output
+    watch_cursor_known = false;
+    watch_cursor_to(watch_rows_used, 0);
+    write(ANSI_SHOW_CURSOR);
+    ushell_release_keystroke_handler();
+}
@@ -0,0 +1,57 @@
+/**
+ * Built-in watch command
+ * ---------------------------------------------
+ *
+ * Periodically re-executes an application and
+ * only transmits those screen cells, which changed
+ * since the previous execution.
+ *
+ * Author: Matthias Bock <mail@matthiasbock.net>
+ * License: GNU GPLv3
+ */
+
+#ifndef USHELL_WATCH_H
+#define USHELL_WATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scratch.h"
+
+// size of the shadow screen capturing the watched command's output
+#define USHELL_WATCH_ROWS       20
+#define USHELL_WATCH_COLUMNS    80
+
+// period to use, if none is specified with -n
+#define USHELL_WATCH_DEFAULT_PERIOD_MS  2000
+
+// terminal row, at which the watched command's output begins
+#define USHELL_WATCH_FIRST_ROW  3
+
+// unchanged cells between two changed cells are retransmitted
+// rather than moving the cursor, if there are fewer than this
+#define USHELL_WATCH_MAX_GAP    6
+
+/**
+ * @brief Built-in command: watch [-n <period>] <command> [arguments]
+ *
+ * The command is re-executed from ushell_poll(), whenever the period elapsed.
+ * Press Ctrl-C to return to the prompt.
+ */
+int ushell_watch(uint8_t argc, char* argv[], ushell_context_t* context);
+
+/**
+ * @brief Re-execute the watched command, if due
+ */
+void ushell_watch_poll();
+
+/**
+ * @brief Time of the next re-execution or USHELL_NO_DEADLINE
+ */
+uint32_t ushell_watch_deadline();
+
+/**
+ * @brief Stop watching and return to the prompt
+ */
+void ushell_watch_stop();
+
+#endif // USHELL_WATCH_H